@@ -0,0 +1,30 @@
+# Builds libgpscore, then gpsGUI, gpsconvert and the benchmarks, which
+# link it.
+
+TEMPLATE = subdirs
+
+SUBDIRS = gpscore gpsgui gpsconvert gpsbenchchecksum gpsbenchdecode gpsbenchsync
+
+# All of them are in this directory, so each gets its own Makefile:
+gpscore.file = gpscore.pro
+gpscore.makefile = Makefile.gpscore
+
+gpsgui.file = gpsgui.pro
+gpsgui.makefile = Makefile.gpsgui
+gpsgui.depends = gpscore
+
+gpsconvert.file = gpsconvert.pro
+gpsconvert.makefile = Makefile.gpsconvert
+gpsconvert.depends = gpscore
+
+gpsbenchchecksum.file = gpsbenchchecksum.pro
+gpsbenchchecksum.makefile = Makefile.gpsbenchchecksum
+gpsbenchchecksum.depends = gpscore
+
+gpsbenchdecode.file = gpsbenchdecode.pro
+gpsbenchdecode.makefile = Makefile.gpsbenchdecode
+gpsbenchdecode.depends = gpscore
+
+gpsbenchsync.file = gpsbenchsync.pro
+gpsbenchsync.makefile = Makefile.gpsbenchsync
+gpsbenchsync.depends = gpscore
@@ -0,0 +1,133 @@
+#include "gpsbinaryreader.h"
+#include "gpssimd.h"
+#include "gpstelegramframer.h"
+
+#include <stdio.h>
+
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QTextStream>
+
+// Microbenchmark of the telegram checksum kernels: sumBytes() and
+// copyAndSumBytes(), scalar against SSE2 and AVX2, over the telegrams of
+// each log given, for example:
+//   gpsbenchchecksum "example logs/"*.log
+
+static const int passes = 200;
+static const char *kernels[] = { "scalar", "SSE2", "AVX2" };
+static volatile uint32_t sink; // keeps the sums from being optimised away
+
+struct telegramSpan {
+    size_t offset;
+    size_t length;
+};
+
+static bool readLog(const char *path, std::vector<uint8_t> &data, std::vector<telegramSpan> &telegrams)
+{
+    FILE *f = fopen(path, "rb");
+    if(f == NULL)
+        return false;
+    uint8_t block[65536];
+    size_t nread;
+    while((nread = fread(block, sizeof(char), sizeof(block), f)) > 0)
+        data.insert(data.end(), block, block + nread);
+    fclose(f);
+
+    gpsTelegramFramer framer;
+    size_t pos = 0;
+    const uint8_t *telegram;
+    size_t length;
+    uint32_t byteSum;
+    while(framer.nextIn(data.data(), data.size(), &pos, &telegram, &length, &byteSum))
+    {
+        telegramSpan t;
+        t.offset = telegram - data.data();
+        t.length = length;
+        telegrams.push_back(t);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QTextStream out(stdout);
+    if(argc < 2)
+    {
+        out << "Usage: gpsbenchchecksum log...\n";
+        return 1;
+    }
+
+    for(int arg=1; arg < argc; arg++)
+    {
+        std::vector<uint8_t> data;
+        std::vector<telegramSpan> telegrams;
+        if(!readLog(argv[arg], data, telegrams) || telegrams.empty())
+        {
+            out << "No telegrams in " << argv[arg] << "\n";
+            return 1;
+        }
+        size_t bytes = 0;
+        for(size_t i=0; i < telegrams.size(); i++)
+            bytes += telegrams[i].length;
+        out << QString("%1: %2 telegrams, %3 bytes, %4 passes\n").arg(argv[arg])
+               .arg(telegrams.size()).arg(bytes).arg(passes);
+
+        // The scalar sums to check the others against:
+        setSimdKernel("scalar");
+        std::vector<uint32_t> expected(telegrams.size());
+        for(size_t i=0; i < telegrams.size(); i++)
+            expected[i] = sumBytes(data.data() + telegrams[i].offset, telegrams[i].length);
+
+        std::vector<uint8_t> copy(gpsBinaryReader::maxTelegramSize);
+        for(size_t k=0; k < sizeof(kernels)/sizeof(kernels[0]); k++)
+        {
+            if(!setSimdKernel(kernels[k]))
+            {
+                out << QString("  %1: not supported by this CPU\n").arg(kernels[k]);
+                continue;
+            }
+            size_t mismatches = 0;
+            uint32_t total = 0;
+            QElapsedTimer timer;
+
+            timer.start();
+            for(int pass=0; pass < passes; pass++)
+            {
+                for(size_t i=0; i < telegrams.size(); i++)
+                    total += sumBytes(data.data() + telegrams[i].offset, telegrams[i].length);
+            }
+            double sumSeconds = timer.nsecsElapsed() / 1E9;
+
+            timer.start();
+            for(int pass=0; pass < passes; pass++)
+            {
+                for(size_t i=0; i < telegrams.size(); i++)
+                {
+                    uint32_t sum = copyAndSumBytes(copy.data(), data.data() + telegrams[i].offset, telegrams[i].length);
+                    if((pass == 0) && (sum != expected[i]))
+                        mismatches++;
+                    total += copy[0];
+                }
+            }
+            double copySeconds = timer.nsecsElapsed() / 1E9;
+
+            for(size_t i=0; i < telegrams.size(); i++)
+            {
+                if(sumBytes(data.data() + telegrams[i].offset, telegrams[i].length) != expected[i])
+                    mismatches++;
+            }
+
+            double count = (double)telegrams.size() * passes;
+            double megabytes = (double)bytes * passes / 1E6;
+            out << QString("  %1 sumBytes %2 ns/telegram %3 MB/s, copyAndSumBytes %4 ns/telegram %5 MB/s, %6 mismatches\n")
+                   .arg(kernels[k], -6)
+                   .arg(sumSeconds * 1E9 / count, 0, 'f', 1).arg(megabytes / sumSeconds, 0, 'f', 0)
+                   .arg(copySeconds * 1E9 / count, 0, 'f', 1).arg(megabytes / copySeconds, 0, 'f', 0)
+                   .arg(mismatches);
+            sink = total;
+        }
+    }
+    return 0;
+}
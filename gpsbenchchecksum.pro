@@ -0,0 +1,17 @@
+# Microbenchmark of the checksum kernels in gpssimd, see gpsbenchchecksum.cpp.
+
+QT       = core
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = gpsbenchchecksum
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+QMAKE_CXXFLAGS += -Wno-class-memaccess
+
+include(gpscore.pri)
+
+SOURCES += \
+    gpsbenchchecksum.cpp
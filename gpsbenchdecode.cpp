@@ -0,0 +1,128 @@
+#include "gpsbinaryfilereader.h"
+#include "gpsparalleldecoder.h"
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QTextStream>
+
+// Checks gpsParallelDecoder against the replay reader, and times it. The
+// log is read once with gpsBinaryFileReader, mapped and in bulk mode, for
+// the counter, validDecode and numberDropped of every message. It is then
+// decoded with gpsParallelDecoder for each chunk size and thread count,
+// and each run must give the same sequence. Small chunks end inside
+// telegrams often, which exercises the stitching. For example:
+//   gpsbenchdecode "example logs/binarygps.log"
+// or, to time only, one chunk size on a large log:
+//   gpsbenchdecode big.log 1048576
+
+struct decodedTelegram {
+    uint32_t counter;
+    bool validDecode;
+    uint32_t numberDropped;
+
+    bool operator==(const decodedTelegram &other) const
+    {
+        return (counter == other.counter) && (validDecode == other.validDecode) &&
+                (numberDropped == other.numberDropped);
+    }
+};
+
+static void keep(std::vector<decodedTelegram> &sequence, const gpsMessage &m)
+{
+    decodedTelegram t;
+    t.counter = m.counter;
+    t.validDecode = m.validDecode;
+    t.numberDropped = m.numberDropped;
+    sequence.push_back(t);
+}
+
+int main(int argc, char *argv[])
+{
+    QTextStream out(stdout);
+    if((argc < 2) || (argc > 3))
+    {
+        out << "Usage: gpsbenchdecode log [chunk size, to time only that]\n";
+        return 1;
+    }
+    bool timeOnly = (argc == 3);
+    std::vector<uint64_t> chunkSizes = { gpsParallelDecoder::defaultChunkSize, 262144, 65536, 4096, 700, 97 };
+    if(timeOnly)
+        chunkSizes = { strtoull(argv[2], NULL, 10) };
+    const unsigned threadCounts[] = { 1, 2, 4, 8 };
+
+    std::vector<decodedTelegram> reference;
+    if(!timeOnly)
+    {
+        // Called directly, on this thread, from inside beginWork():
+        gpsBinaryFileReader reader;
+        QObject::connect(&reader, &gpsBinaryFileReader::haveGPSMessage,
+                         [&reference](gpsMessage m) { keep(reference, m); });
+        QObject::connect(&reader, &gpsBinaryFileReader::haveGPSMessageBatch,
+                         [&reference](gpsMessageBatch batch) {
+            for(size_t i=0; i < batch->size(); i++)
+                keep(reference, batch->at(i));
+        });
+        reader.setMappedMode(true);
+        reader.setBulkMode(true);
+        reader.setFilename(argv[1]);
+        QElapsedTimer timer;
+        timer.start();
+        reader.beginWork();
+        double seconds = timer.nsecsElapsed() / 1E9;
+        out << QString("Replay reader: %1 telegrams in %2 s, %3 telegrams/s\n").arg(reference.size())
+               .arg(seconds, 0, 'f', 3).arg(seconds > 0 ? reference.size() / seconds : 0, 0, 'f', 0);
+    }
+
+    int differences = 0;
+    for(size_t c=0; c < chunkSizes.size(); c++)
+    {
+        for(size_t t=0; t < sizeof(threadCounts)/sizeof(threadCounts[0]); t++)
+        {
+            gpsParallelDecoder decoder;
+            int err = decoder.open(argv[1]);
+            if(err != 0)
+            {
+                out << "Cannot open " << argv[1] << "\n";
+                return 1;
+            }
+            decoder.setChunkSize(chunkSizes[c]);
+            decoder.setThreads(threadCounts[t]);
+
+            std::vector<decodedTelegram> sequence;
+            QElapsedTimer timer;
+            timer.start();
+            decoder.run([&sequence, timeOnly](const std::vector<gpsMessage> &messages,
+                        const std::vector<gpsDecodeStatus> &) {
+                if(!timeOnly)
+                {
+                    for(size_t i=0; i < messages.size(); i++)
+                        keep(sequence, messages[i]);
+                }
+                return true;
+            });
+            double seconds = timer.nsecsElapsed() / 1E9;
+
+            QString result;
+            if(!timeOnly)
+            {
+                result = (sequence == reference) ? ", same" : ", DIFFERENT";
+                if(!(sequence == reference))
+                    differences++;
+            }
+            out << QString("Chunks of %1 bytes, %2 threads: %3 chunks, %4 telegrams, %5 errors, "
+                           "%6 dropped in %7 gaps, %8 resyncs, %9 telegrams/s")
+                   .arg(chunkSizes[c]).arg(decoder.getThreads()).arg(decoder.getChunks())
+                   .arg(decoder.getTelegrams()).arg(decoder.getDecodeErrors())
+                   .arg(decoder.getDropped()).arg(decoder.getDropEvents())
+                   .arg(decoder.getBoundaryResyncs())
+                   .arg(seconds > 0 ? decoder.getTelegrams() / seconds : 0, 0, 'f', 0)
+                << result << "\n";
+        }
+    }
+    return differences ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+# Check and benchmark of gpsParallelDecoder, see gpsbenchdecode.cpp.
+
+QT       = core
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = gpsbenchdecode
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+QMAKE_CXXFLAGS += -Wno-class-memaccess
+
+include(gpscore.pri)
+
+SOURCES += \
+    gpsbenchdecode.cpp
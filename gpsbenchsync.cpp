@@ -0,0 +1,163 @@
+#include "gpssimd.h"
+#include "gpstelegramframer.h"
+
+#include <stdio.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QTextStream>
+
+// Benchmark of finding telegrams in heavily corrupted data, for the "IX"
+// sync search in gpssimd and gpsTelegramFramer. The telegrams of a good
+// log are copied out with garbage between them and some of them damaged,
+// in three strengths:
+//   0  random bytes between telegrams
+//   1  the same, with one byte in four an 'I'
+//   2  the same, with fake "IX" headers of plausible sizes as well
+// and there are two 64 MB buffers with no telegrams at all, one of random
+// bytes and one with one byte in three an 'I'. Each is framed with
+// gpsTelegramFramer::nextIn() using the scalar, SSE2 and AVX2 kernels.
+// The corruption is seeded, so runs are comparable. For example:
+//   gpsbenchsync "example logs/binarygps.log" /tmp
+// also writes the corrupted logs, as /tmp/corrupt0.log and so on.
+
+static const int passes = 20;
+static const char *kernels[] = { "scalar", "SSE2", "AVX2" };
+
+static bool readLog(const char *path, std::vector<uint8_t> &data)
+{
+    FILE *f = fopen(path, "rb");
+    if(f == NULL)
+        return false;
+    uint8_t block[65536];
+    size_t nread;
+    while((nread = fread(block, sizeof(char), sizeof(block), f)) > 0)
+        data.insert(data.end(), block, block + nread);
+    fclose(f);
+    return true;
+}
+
+static size_t corrupt(const std::vector<uint8_t> &log, int strength, std::mt19937 &rng, std::vector<uint8_t> &out)
+{
+    // Returns how many telegrams were left undamaged.
+    gpsTelegramFramer framer;
+    size_t pos = 0;
+    const uint8_t *telegram;
+    size_t length;
+    uint32_t byteSum;
+    size_t kept = 0;
+    while(framer.nextIn(log.data(), log.size(), &pos, &telegram, &length, &byteSum))
+    {
+        size_t gap = (rng() % 3 == 0) ? rng() % 2000 : 0;
+        for(size_t i=0; i < gap; i++)
+        {
+            if((strength >= 2) && (rng() % 40 == 0))
+            {
+                // "IX", version 5, then a size of 356 at bytes 17 and 18:
+                out.push_back('I');
+                out.push_back('X');
+                out.push_back(5);
+                for(int k=0; k < 14; k++)
+                    out.push_back(rng());
+                out.push_back(1);
+                out.push_back(100);
+                i += 18;
+                continue;
+            }
+            uint8_t c = rng();
+            if((strength >= 1) && (rng() % 4 == 0))
+                c = 'I';
+            out.push_back(c);
+        }
+
+        size_t start = out.size();
+        out.insert(out.end(), telegram, telegram + length);
+        if((rng() % 50 == 0) && (length > 300))
+            out[start + 100 + rng() % 200] ^= 0x55; // breaks the checksum
+        else
+            kept++;
+    }
+    return kept;
+}
+
+static void frame(QTextStream &out, const QString &name, const std::vector<uint8_t> &data, size_t expected)
+{
+    out << QString("%1: %2 bytes").arg(name).arg(data.size());
+    if(expected)
+        out << QString(", %1 good telegrams").arg(expected);
+    out << "\n";
+
+    for(size_t k=0; k < sizeof(kernels)/sizeof(kernels[0]); k++)
+    {
+        if(!setSimdKernel(kernels[k]))
+        {
+            out << QString("  %1: not supported by this CPU\n").arg(kernels[k]);
+            continue;
+        }
+        gpsTelegramFramer framer;
+        size_t found = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for(int pass=0; pass < passes; pass++)
+        {
+            size_t pos = 0;
+            const uint8_t *telegram;
+            size_t length;
+            uint32_t byteSum;
+            found = 0;
+            while(framer.nextIn(data.data(), data.size(), &pos, &telegram, &length, &byteSum))
+                found++;
+        }
+        double seconds = timer.nsecsElapsed() / 1E9 / passes;
+        out << QString("  %1 %2 MB/s, %3 telegrams found, %4 checksum rejects\n").arg(kernels[k])
+               .arg(data.size() / seconds / 1E6, 0, 'f', 0).arg(found)
+               .arg(framer.getChecksumRejects() / passes);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QTextStream out(stdout);
+    std::vector<uint8_t> log;
+    if((argc < 2) || (argc > 3))
+    {
+        out << "Usage: gpsbenchsync log [directory for the corrupted logs]\n";
+        return 1;
+    }
+    if(!readLog(argv[1], log))
+    {
+        out << "Cannot read " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::mt19937 rng(1);
+    for(int strength=0; strength < 3; strength++)
+    {
+        std::vector<uint8_t> data;
+        size_t kept = corrupt(log, strength, rng, data);
+        QString name = QString("corrupt%1.log").arg(strength);
+        if(argc == 3)
+        {
+            std::string path = std::string(argv[2]) + "/" + name.toStdString();
+            FILE *f = fopen(path.c_str(), "wb");
+            if((f == NULL) || (fwrite(data.data(), sizeof(char), data.size(), f) != data.size()))
+                out << "Cannot write " << path.c_str() << "\n";
+            if(f != NULL)
+                fclose(f);
+        }
+        frame(out, name, data, kept);
+    }
+
+    std::vector<uint8_t> garbage(64 << 20);
+    for(size_t i=0; i < garbage.size(); i++)
+        garbage[i] = rng();
+    frame(out, "64 MB random", garbage, 0);
+    for(size_t i=0; i < garbage.size(); i++)
+        garbage[i] = (rng() % 3 == 0) ? 'I' : rng();
+    frame(out, "64 MB one in three 'I'", garbage, 0);
+    return 0;
+}
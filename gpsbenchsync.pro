@@ -0,0 +1,17 @@
+# Benchmark of framing corrupted logs, see gpsbenchsync.cpp.
+
+QT       = core
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = gpsbenchsync
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+QMAKE_CXXFLAGS += -Wno-class-memaccess
+
+include(gpscore.pri)
+
+SOURCES += \
+    gpsbenchsync.cpp
@@ -1,13 +1,20 @@
 #include "gpsbinaryfilereader.h"
 
+#include <string.h>
+#include <sys/stat.h>
+
+#include <QElapsedTimer>
+
 gpsBinaryFileReader::gpsBinaryFileReader()
 {
     filenameSet = false;
     readFirstLine = false;
     fileOpen = false;
     maximumMessageSize = 512; // 391 is max seen
-    // This is how fast the file plays back:
-    messageDelayMicroSeconds = 1E6 / 200.0;
+    seekPending = false;
+    bulkMode = false;
+    mappedModeWanted = false;
+    batchesInFlight = std::make_shared<std::atomic<int>>(0);
     rawData = (char*)malloc(maximumMessageSize); // bytes to hold a message read
 }
 
@@ -18,12 +25,12 @@ gpsBinaryFileReader::~gpsBinaryFileReader()
     free(rawData);
 }
 
-void gpsBinaryFileReader::setSpeedupFactor(int factor)
+void gpsBinaryFileReader::setSpeedupFactor(double factor)
 {
-    if(factor >0)
+    if(factor > 0)
     {
         qDebug() << "Setting replay factor to: " << factor;
-        messageDelayMicroSeconds = (1E6 / 200.0) / factor;
+        replayClock.setSpeed(factor);
     }
 }
 
@@ -33,9 +40,28 @@ void gpsBinaryFileReader::beginWork()
     if(fileOpen)
         return;
     keepGoing = true;
+    useMapping = mappedModeWanted;
+    replayClock.reset();
+    batchesSent = 0;
+    QElapsedTimer replayTimer;
+    replayTimer.start();
     startProcessFile();
+    sendBatch(); // what is left at the end of the file
     closeFile();
+    double seconds = replayTimer.nsecsElapsed() / 1E9;
+    emit haveStatusMessage(QString("Read %1 telegrams in %2 s, %3 telegrams/s sustained (%4, %5 read, %6 batches).")
+                           .arg(messagesRead).arg(seconds, 0, 'f', 3)
+                           .arg(seconds > 0 ? messagesRead / seconds : 0, 0, 'f', 0)
+                           .arg(bulkMode ? "bulk" : "paced").arg(useMapping ? "mapped" : "stdio")
+                           .arg(batchesSent));
     messagesRead = 0;
+    if(replayClock.getTelegrams() > 0)
+        emit haveStatusMessage(QString("Replayed %1 telegrams at %2x speed. Lateness mean %3 us, jitter %4 us, max %5 us, %6 resyncs.")
+                               .arg(replayClock.getTelegrams()).arg(replayClock.getSpeed())
+                               .arg(replayClock.getMeanLatenessMicroseconds(), 0, 'f', 1)
+                               .arg(replayClock.getJitterMicroseconds(), 0, 'f', 1)
+                               .arg(replayClock.getMaxLatenessMicroseconds(), 0, 'f', 1)
+                               .arg(replayClock.getResyncs()));
 }
 
 void gpsBinaryFileReader::stopWork()
@@ -53,50 +79,103 @@ void gpsBinaryFileReader::startProcessFile()
     if(!fileOpen)
         return;
 
-    emit haveStatusMessage(QString("Starting to read file [%1]").arg(filename));
+    bool container = isContainerFile();
+    emit haveStatusMessage(QString("Starting to read %1file [%2]").arg(container ? "container " : "").arg(filename));
+    bool wasBulk = bulkMode;
     while(ok && keepGoing)
     {
-
-        found = findMessage(); // Block while looking through the file
-                               // advance file two bytes in the process
-        if(!found)
+        if(seekPending)
         {
-            // We read the entire file, didn't find anything
-            emit haveErrorMessage(QString("Error: read entire file [%1], no (further) GPS data found.").arg(filename));
-            return;
+            sendBatch(); // from before the seek
+            applySeek();
+        }
+        bool bulk = bulkMode;
+        if(bulk != wasBulk)
+        {
+            sendBatch();
+            replayClock.restart(); // paced from here, not from where bulk mode began
+            wasBulk = bulk;
         }
 
-        // Read the size of the next message from the message header:
-        messageSizeBytes = readV5header(); // read the next 27-2 bytes
-        //emit haveStatusMessage(QString("Read header for messageCount %1. Telegram size is %2 bytes.").arg(messagesRead).arg(messageSizeBytes)  );
-
-        ok = readRestOfMessage(); // read message bytes, copy into rawData, and set binMessage to point into rawData.
+        const uint8_t *telegram = (const uint8_t*)rawData;
+        size_t telegramLength = 0;
+        uint32_t byteSum = 0;
+        if(useMapping)
+        {
+            if(!nextMappedTelegram(container, &telegram, &telegramLength, &byteSum))
+            {
+                emit haveStatusMessage(QString("Read to the end of file [%1]: %2 telegrams, %3 bytes skipped, %4 checksum failures.")
+                                       .arg(filename).arg(framer.getTelegrams())
+                                       .arg(framer.getBytesSkipped()).arg(framer.getChecksumRejects()));
+                emit haveErrorMessage(QString("Error: read entire file [%1], no (further) GPS data found.").arg(filename));
+                return;
+            }
+            messageSizeBytes = telegramLength;
+            binMessage.setRawData((const char*)telegram, telegramLength);
+        } else if(container)
+        {
+            if(!readContainerRecord())
+            {
+                emit haveErrorMessage(QString("Error: read entire file [%1], no (further) GPS data found.").arg(filename));
+                return;
+            }
+        } else {
+            found = findMessage(); // Block while looking through the file
+                                   // advance file two bytes in the process
+            if(!found)
+            {
+                // We read the entire file, didn't find anything
+                emit haveErrorMessage(QString("Error: read entire file [%1], no (further) GPS data found.").arg(filename));
+                return;
+            }
+
+            // Read the size of the next message from the message header:
+            messageSizeBytes = readV5header(); // read the next 27-2 bytes
+            //emit haveStatusMessage(QString("Read header for messageCount %1. Telegram size is %2 bytes.").arg(messagesRead).arg(messageSizeBytes)  );
+
+            ok = readRestOfMessage(); // read message bytes, copy into rawData, and set binMessage to point into rawData.
+        }
 
-        reader.insertData(QByteArray(binMessage)); // make a copy, just to be safe
+        if(useMapping)
+            reader.insertData(telegram, telegramLength, byteSum); // decode in place, in the mapping
+        else
+            reader.insertData((const uint8_t*)rawData, binMessage.length()); // decode in place
         m = reader.getMessage();
-        if(m.validDecode)
+        if(m.validDecode && bulk)
+        {
+            addToBatch(m);
+        } else if(m.validDecode)
         {
+            // Wait until it is due, by its own time:
+            replayClock.waitFor(m.navDataValidityTime);
             // Here is where the complete, properly-decoded message is.
             emit haveGPSMessage(m);
         } else {
             emit haveErrorMessage(QString("Invalid decode. Message number %1 with counter value %2, error message: [%3], message checksum: %4, calculated message checksum: %5, byte array length: %6, message telegram claimed size: %7")\
                                   .arg(messagesRead).arg(m.counter)\
-                                  .arg(m.lastDecodeErrorMessage)\
+                                  .arg(gpsBinaryReader::decodeErrorString(m))\
                                   .arg(m.claimedMessageSum)\
                                   .arg(m.calculatedChecksum)\
                                   .arg(binMessage.length())\
                                   .arg(messageSizeBytes));
             //debugReader.printMessage(m);
-            emit haveGPSMessage(m);
+            if(bulk)
+                addToBatch(m);
+            else
+                emit haveGPSMessage(m);
         }
         messagesRead++;
-        // TODO: Automatically replay at the same speed as the file,
-        // using the change in microseconds between messages.
-        // First file sets the offset, then we count and wait between.
-        usleep(messageDelayMicroSeconds);
-        while(paused)
+        if(!bulk && ((messagesRead % positionInterval) == 0))
+            emit haveReplayPosition(fileSize ? (double)filePosition() / fileSize : 0);
+        if(paused)
         {
-            usleep(10000);
+            sendBatch();
+            // A seek while paused shows the one telegram there:
+            while(paused && !seekPending)
+            {
+                usleep(10000);
+            }
+            replayClock.restart(); // carry on from here, not from before the pause
         }
     }
 
@@ -104,38 +183,87 @@ void gpsBinaryFileReader::startProcessFile()
     closeFile();
 }
 
-bool gpsBinaryFileReader::findMessage()
+void gpsBinaryFileReader::addToBatch(const gpsMessage &m)
 {
-    bool lookingForMessageStart = true;
-    size_t nread = 0;
-    long offset = 0;
-    (void)offset; // keep this variable around for debug.
-    volatile uint64_t readCount = 0;
-    offset = ftell(binFilePtr);
-    //emit haveStatusMessage(QString("findMessage: starting read at offset value: %1").arg(offset));
+    if(batch.isNull())
+    {
+        // Counted until the last receiver lets go of it:
+        std::shared_ptr<std::atomic<int>> inFlight = batchesInFlight;
+        batch = gpsMessageBatch(new std::vector<gpsMessage>, [inFlight](std::vector<gpsMessage> *b) {
+            (*inFlight)--;
+            delete b;
+        });
+        (*batchesInFlight)++;
+        batch->reserve(batchLimit);
+        batchTimer.start();
+    }
+    batch->push_back(m);
+    if((batch->size() >= batchLimit) || (batchTimer.elapsed() >= batchInterval))
+        sendBatch();
+}
 
+void gpsBinaryFileReader::sendBatch()
+{
+    if(batch.isNull())
+        return;
+    // This one is counted too:
+    while((*batchesInFlight > maxBatchesInFlight) && keepGoing)
+        usleep(1000);
+    emit haveGPSMessageBatch(batch);
+    batch = gpsMessageBatch();
+    batchesSent++;
+    emit haveReplayPosition(fileSize ? (double)filePosition() / fileSize : 0);
+}
 
-    while(lookingForMessageStart)
+bool gpsBinaryFileReader::findMessage()
+{
+    // Read ahead a block at a time and look for the next plausible
+    // telegram in it, rather than a byte at a time for "IX".
+    // Leaves the file just past the "IX", as readV5header() expects.
+    // The first block holds a whole telegram, which is usually right
+    // there; the rest are larger for skipping over damage.
+    const size_t scanBlockSize = 65536;
+    scanBuffer.resize(2 * maximumMessageSize);
+    off_t start = ftello(binFilePtr);
+    uint64_t skipped = 0;
+
+    while(true)
     {
-        nread = fread(rawData, sizeof(char), 2, binFilePtr);
-        offset = ftell(binFilePtr);
-        if(nread != 2)
+        size_t nread = fread(scanBuffer.data(), sizeof(char), scanBuffer.size(), binFilePtr);
+        if(nread < 2)
         {
-            emit haveErrorMessage(QString("findMessage: Tried to read %1 bytes but read %2 instead. Read %3 times.").arg(2).arg(nread).arg(readCount));
+            emit haveErrorMessage(QString("findMessage: reached the end of the file, skipped %1 bytes looking for a telegram.").arg(skipped + nread));
             return false;
         }
-        if(strncmp(rawData, "IX", 2) == 0)
+        size_t length = 0;
+        const uint8_t *telegram = gpsTelegramFramer::findTelegram(scanBuffer.data(), nread, &length);
+        if(telegram == NULL)
         {
-            lookingForMessageStart = false;
-            //emit haveStatusMessage(QString("findMessage: ***FOUND*** IX at readcount %1, with offset %2.").arg(readCount).arg(offset));
-        } else {
-            // Scoot back one byte
-            //emit haveErrorMessage(QString("findMessage: Found bytes %1 and %2 with attempt %3 at offset %4.").arg(rawData[0]).arg(rawData[1]).arg(readCount).arg(offset));
-            fseek(binFilePtr, -1, SEEK_CUR);
+            // Nothing here, and the file is already at the next block.
+            start += nread;
+            skipped += nread;
+            scanBuffer.resize(scanBlockSize);
+            continue;
+        }
+        size_t at = telegram - scanBuffer.data();
+        skipped += at;
+        if((length == 0) && (nread == scanBuffer.size()) &&
+                ((at > 0) || (scanBuffer.size() < scanBlockSize)))
+        {
+            // Runs past the end of the block; read it again from its start
+            // so that it can be checked.
+            start += at;
+            fseeko(binFilePtr, start, SEEK_SET);
+            scanBuffer.resize(scanBlockSize);
+            continue;
         }
-        readCount++;
+        if(skipped > 0)
+            emit haveStatusMessage(QString("findMessage: skipped %1 bytes to the next telegram.").arg(skipped));
+        fseeko(binFilePtr, start + at + 2, SEEK_SET);
+        rawData[0] = 'I';
+        rawData[1] = 'X';
+        return true;
     }
-    return !lookingForMessageStart;
 }
 
 uint16_t gpsBinaryFileReader::readV5header()
@@ -169,6 +297,11 @@ bool gpsBinaryFileReader::readRestOfMessage()
 
     // Note: the checksum will fail if we transfer too many bytes in
 
+    if(messageSizeBytes < headerV5sizeBytes + 4)
+    {
+        emit haveErrorMessage(QString("readRestOfMessage: telegram size %1 is too small for the header.").arg(messageSizeBytes));
+        return false;
+    }
     size_t nBytesToRead =  messageSizeBytes - headerV5sizeBytes; // the +100 is a debug method to make sure we read enough
     nread = fread(rawData+2+headerV5sizeBytes-2, sizeof(char), nBytesToRead, binFilePtr);
     if(nread != size_t(nBytesToRead))
@@ -185,6 +318,175 @@ bool gpsBinaryFileReader::readRestOfMessage()
 
 }
 
+bool gpsBinaryFileReader::isContainerFile()
+{
+    if(useMapping)
+        return gpsContainer::isContainer(mappedFile.data(), mappedFile.size());
+    uint8_t first[gpsContainer::recordHeaderSize];
+    size_t nread = fread(first, sizeof(char), sizeof(first), binFilePtr);
+    rewind(binFilePtr);
+    return gpsContainer::isContainer(first, nread);
+}
+
+bool gpsBinaryFileReader::readContainerRecord()
+{
+    // Every telegram is one record, so there is no looking for "IX".
+    // Header, index and end records are stepped over.
+    uint8_t header[gpsContainer::recordHeaderSize];
+    gpsRecordHeader h;
+    size_t nread = 0;
+    while(true)
+    {
+        nread = fread(header, sizeof(char), sizeof(header), binFilePtr);
+        if(nread != sizeof(header))
+            return false; // end of the file
+        if(!gpsContainer::getRecordHeader(header, h))
+        {
+            // Damaged, look for the next record one byte on:
+            fseeko(binFilePtr, 1 - (off_t)sizeof(header), SEEK_CUR);
+            continue;
+        }
+        if((h.kind == recordTelegram) && (h.length <= maximumMessageSize))
+            break;
+        if(h.kind == recordTelegram)
+            emit haveErrorMessage(QString("readContainerRecord: skipping telegram record of %1 bytes at offset %2.").arg(h.length).arg((qint64)ftello(binFilePtr)));
+        if(fseeko(binFilePtr, h.length, SEEK_CUR) != 0)
+            return false;
+    }
+
+    nread = fread(rawData, sizeof(char), h.length, binFilePtr);
+    if(nread != h.length)
+    {
+        emit haveErrorMessage(QString("readContainerRecord: Tried to read %1 bytes but read %2 instead.").arg(h.length).arg(nread));
+        return false;
+    }
+    messageSizeBytes = h.length;
+    binMessage.setRawData(rawData, messageSizeBytes);
+    return true;
+}
+
+bool gpsBinaryFileReader::nextMappedTelegram(bool container, const uint8_t **telegram, size_t *length, uint32_t *byteSum)
+{
+    const uint8_t *data = mappedFile.data();
+    uint64_t size = mappedFile.size();
+    if(!container)
+    {
+        size_t pos = mappedPos;
+        bool found = framer.nextIn(data, size, &pos, telegram, length, byteSum);
+        mappedPos = pos;
+        return found;
+    }
+
+    // One record at a time; the framer checks each telegram record:
+    while(mappedPos + gpsContainer::recordHeaderSize <= size)
+    {
+        gpsRecordHeader h;
+        if(!gpsContainer::getRecordHeader(data + mappedPos, h))
+        {
+            mappedPos++; // damaged, look for the next record one byte on
+            continue;
+        }
+        uint64_t payload = mappedPos + gpsContainer::recordHeaderSize;
+        if(payload + h.length > size)
+            return false; // cut short
+        mappedPos = payload + h.length;
+        size_t pos = 0;
+        if((h.kind == recordTelegram) &&
+                framer.nextIn(data + payload, h.length, &pos, telegram, length, byteSum) &&
+                (*length == h.length))
+            return true;
+    }
+    return false;
+}
+
+void gpsBinaryFileReader::seekToCounter(uint32_t counter)
+{
+    requestSeek(seekCounter, counter);
+}
+
+void gpsBinaryFileReader::seekToTime(uint32_t navDataValidityTime)
+{
+    requestSeek(seekTime, navDataValidityTime);
+}
+
+void gpsBinaryFileReader::seekToFraction(double fraction)
+{
+    requestSeek(seekFraction, fraction);
+}
+
+void gpsBinaryFileReader::requestSeek(seekKinds kind, double target)
+{
+    std::lock_guard<std::mutex> lock(seekMutex);
+    seekKind = kind;
+    seekTarget = target;
+    seekPending = true;
+}
+
+void gpsBinaryFileReader::applySeek()
+{
+    seekKinds kind;
+    double target;
+    {
+        std::lock_guard<std::mutex> lock(seekMutex);
+        kind = seekKind;
+        target = seekTarget;
+        seekPending = false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    if(!seeker.isOpen() || (seeker.getPath() != filename.toStdString()))
+    {
+        int err = seeker.open(filename.toStdString());
+        if(err != 0)
+        {
+            emit haveErrorMessage(QString("Cannot seek in file [%1]: %2").arg(filename).arg(strerror(err)));
+            return;
+        }
+    }
+    uint64_t offset;
+    switch(kind)
+    {
+    case seekCounter:
+        offset = seeker.offsetOfCounter(target);
+        break;
+    case seekTime:
+        offset = seeker.offsetOfTime(target);
+        break;
+    default:
+        offset = seeker.offsetOfFraction(target);
+        break;
+    }
+
+    if(useMapping)
+        mappedPos = offset;
+    else
+        fseeko(binFilePtr, offset, SEEK_SET);
+    replayClock.restart();
+    emit haveReplayPosition(fileSize ? (double)offset / fileSize : 0);
+    emit haveStatusMessage(QString("Seeked to offset %1 of file [%2] in %3 ms.")
+                           .arg(offset).arg(filename).arg(timer.nsecsElapsed() / 1E6, 0, 'f', 2));
+}
+
+uint64_t gpsBinaryFileReader::filePosition()
+{
+    if(useMapping)
+        return mappedPos;
+    return ftello(binFilePtr);
+}
+
+void gpsBinaryFileReader::setMappedMode(bool mapped)
+{
+    qDebug() << "Setting mapped read mode to: " << mapped;
+    mappedModeWanted = mapped;
+}
+
+void gpsBinaryFileReader::setBulkMode(bool bulk)
+{
+    qDebug() << "Setting bulk replay mode to: " << bulk;
+    bulkMode = bulk;
+}
+
 void gpsBinaryFileReader::setFilename(QString filename)
 {
     if(!filename.isEmpty())
@@ -196,6 +498,20 @@ void gpsBinaryFileReader::setFilename(QString filename)
 
 void gpsBinaryFileReader::openFile()
 {
+    if(filenameSet && (!fileOpen) && useMapping)
+    {
+        int err = mappedFile.open(filename.toStdString());
+        if(err != 0)
+        {
+            emit haveFileReadError(err);
+            emit haveErrorMessage(QString("Error mapping binary gps file [%1] for reading: %2").arg(filename).arg(strerror(err)));
+        } else {
+            mappedPos = 0;
+            fileSize = mappedFile.size();
+            fileOpen = true;
+        }
+        return;
+    }
     if(filenameSet && (!fileOpen) && (binFilePtr==NULL))
     {
         binFilePtr = fopen(filename.toStdString().c_str() ,"rb");
@@ -206,6 +522,8 @@ void gpsBinaryFileReader::openFile()
             emit haveErrorMessage(QString("Error opening binary gps file [%1] for reading: %2").arg(filename).arg(lastFileError));
             fileOpen = false;
         } else {
+            struct stat st;
+            fileSize = (fstat(fileno(binFilePtr), &st) == 0) ? st.st_size : 0;
             fileOpen = true;
         }
     }
@@ -213,6 +531,12 @@ void gpsBinaryFileReader::openFile()
 
 void gpsBinaryFileReader::closeFile()
 {
+    if(fileOpen && mappedFile.isOpen())
+    {
+        mappedFile.close();
+        fileOpen = false;
+        return;
+    }
     if(fileOpen && (binFilePtr != NULL))
     {
         int rtnVal = fclose(binFilePtr);
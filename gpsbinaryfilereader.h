@@ -2,10 +2,25 @@
 #define GPSBINARYFILEREADER_H
 
 #include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QSharedPointer>
 
 #include "gpsbinaryreader.h"
+#include "gpslogcontainer.h"
+#include "gpslogseeker.h"
+#include "gpsmappedfile.h"
+#include "gpsreplayclock.h"
+#include "gpstelegramframer.h"
+
+// Messages decoded in bulk mode, sent together in one signal:
+typedef QSharedPointer<std::vector<gpsMessage>> gpsMessageBatch;
+Q_DECLARE_METATYPE(gpsMessageBatch)
 
 class gpsBinaryFileReader : public QObject
 {
@@ -36,30 +51,82 @@ class gpsBinaryFileReader : public QObject
 
     void startProcessFile();
     bool findMessage(); // move file to start of message
+    std::vector<uint8_t> scanBuffer; // for findMessage()
     uint16_t readV5header(); // return the size
     bool readRestOfMessage(); // read messageSizeBytes, place into rawData at +2
-
-
-
+    bool isContainerFile(); // leaves the file at the start
+    bool readContainerRecord(); // skip to the next telegram record, place into rawData
+
+    // Mapped mode: the file is walked in memory and telegrams are decoded
+    // where they lie, with no copying.
+    bool useMapping = false; // for the file being read
+    std::atomic<bool> mappedModeWanted; // from the next beginWork()
+    gpsMappedFile mappedFile;
+    uint64_t mappedPos = 0;
+    gpsTelegramFramer framer;
+    gpsReplayClock replayClock;
+    bool nextMappedTelegram(bool container, const uint8_t **telegram, size_t *length, uint32_t *byteSum);
+
+    // Seeking: asked for from any thread, done by the replay loop.
+    enum seekKinds {
+        seekCounter,
+        seekTime,
+        seekFraction
+    };
+    std::mutex seekMutex;
+    std::atomic<bool> seekPending;
+    seekKinds seekKind = seekFraction;
+    double seekTarget = 0;
+    gpsLogSeeker seeker; // opened on the first seek
+    uint64_t fileSize = 0;
+    void requestSeek(seekKinds kind, double target);
+    void applySeek();
+    uint64_t filePosition();
+
+    // Bulk mode: no pacing. Messages are gathered into a batch, sent when
+    // batchInterval has passed or batchLimit is reached. While more than
+    // maxBatchesInFlight are still held by the receivers, the reader waits,
+    // so that a slow receiver slows the replay instead of the event queue
+    // growing without bound.
+    std::atomic<bool> bulkMode;
+    gpsMessageBatch batch;
+    QElapsedTimer batchTimer;
+    std::shared_ptr<std::atomic<int>> batchesInFlight; // shared with the batches, which outlive the reader
+    uint64_t batchesSent = 0;
+    void addToBatch(const gpsMessage &m);
+    void sendBatch();
 
 public:
     gpsBinaryFileReader();
     ~gpsBinaryFileReader();
     bool keepGoing = true;
-    unsigned int messageDelayMicroSeconds = 0;
     bool paused = false;
+    static const uint64_t positionInterval = 100; // telegrams between haveReplayPosition()
+    static const size_t batchLimit = 8192; // messages, about 7 MB
+    static const int batchInterval = 50; // ms
+    static const int maxBatchesInFlight = 3;
+
+    // From any thread. Takes effect at the next telegram of a replay,
+    // or from the start of the next replay.
+    void seekToCounter(uint32_t counter);
+    void seekToTime(uint32_t navDataValidityTime); // 100 us since midnight UTC
+    void seekToFraction(double fraction);
 
 public slots:
     void setFilename(QString filename);
     void beginWork(); // start from beginning of the file
     void stopWork();
-    void setSpeedupFactor(int factor); // 1 = real time
+    void setSpeedupFactor(double factor); // 1 = real time; may be called directly while replaying
+    void setMappedMode(bool mapped); // takes effect from the next beginWork(); may be called directly
+    void setBulkMode(bool bulk); // as fast as possible, in batches; may be called directly while replaying
 
 signals:
     void haveGPSMessage(gpsMessage msg);
+    void haveGPSMessageBatch(gpsMessageBatch batch); // bulk mode only
     void haveFileReadError(int errorNum);
     void haveErrorMessage(QString errorMessage);
     void haveStatusMessage(QString statusMessage);
+    void haveReplayPosition(double fraction); // of the file
 };
 
 #endif // GPSBINARYFILEREADER_H
@@ -1,7 +1,17 @@
 #include "gpsbinarylogger.h"
+#include "gpsbinaryreader.h"
+#include "gpslogindex.h"
 
-gpsBinaryLogger::gpsBinaryLogger()
+#include <errno.h>
+#include <limits.h>
+#include <chrono>
+#include <sys/uio.h>
+
+gpsBinaryLogger::gpsBinaryLogger() :
+    lastFileIOError(0), queue(writerQueueSize), writerRunning(false), writeCalls(0), bytesWritten(0)
 {
+    logFile = new gpsLogFile();
+    nextLogFile = new gpsLogFile();
 
     idealBufferSize = 100; // messages to buffer before writing to file
     messageCount = 0; // lifetime message counter
@@ -15,9 +25,14 @@ gpsBinaryLogger::gpsBinaryLogger()
 gpsBinaryLogger::~gpsBinaryLogger()
 {
     // Write out the rest of the buffer:
-    writeBufferToFile();
+    if(useWriterThread)
+        stopWriterThread();
+    else
+        writeBufferToFile();
     // Close file (and wait for any file i/o buffering to complete):
     closeFileWriting();
+    delete logFile;
+    delete nextLogFile;
 
     // done
 }
@@ -40,9 +55,11 @@ void gpsBinaryLogger::startLogging()
     openFileWriting();
     if(lastFileIOError==0)
     {
+        if(useWriterThread && fileIsOpen)
+            startWriterThread();
         loggingAllowed = true;
     } else {
-        emit haveStatusMessage(logRankingStr + QString("Error, logging not allowed. lastFileIOError: %1").arg(lastFileIOError));
+        emit haveStatusMessage(logRankingStr + QString("Error, logging not allowed. lastFileIOError: %1").arg(lastFileIOError.load()));
     }
 }
 
@@ -53,6 +70,8 @@ void gpsBinaryLogger::stopLogging()
         closingLogOut = true;
         loggingAllowed = false;
         usleep(100000); // wait long enough that whatever is in queue finished
+        if(useWriterThread)
+            stopWriterThread(); // writes out whatever is still queued
 
         //emit haveStatusMessage(logRankingStr + QString("About to stop logging."));
         //emit haveStatusMessage(logRankingStr + QString("Finishing buffer to file."));
@@ -102,6 +121,31 @@ void gpsBinaryLogger::openFileWriting()
             emit haveStatusMessage(logRankingStr + QString("Error, file pointer was already open!!"));
             return;
         }
+        if(useWriterThread)
+        {
+            // The writer thread has its own files, see writeViews().
+            segmentNamed = false;
+            segmentCount = 1;
+            segmentStarted = std::chrono::steady_clock::now();
+            lastAheadError = 0;
+            QString path = rotation.enabled() ? aheadFilename() : filename;
+            int err = logFile->open(path.toStdString(), useUring, uringDirectIO, segmentPreallocation());
+            if(err != 0)
+            {
+                lastFileIOError = err;
+                emit haveStatusMessage(logRankingStr + QString("Error, cannot open [%1] for writing, error %2!!").arg(path).arg(err));
+                return;
+            }
+            if(logFormat == logFormatContainer)
+                startContainerFile(logFile);
+            if(useUring && !logFile->usesUring())
+                emit haveStatusMessage(logRankingStr + QString("Warning, cannot write [%1] with io_uring, error %2. Using plain writes instead.").arg(path).arg(logFile->getUringError()));
+            emit haveStatusMessage(logRankingStr + QString("Opened gps binary log file [%1] successfully for%2 append write.")
+                                   .arg(path).arg(logFile->usesUring() ? (logFile->isDirect() ? " io_uring O_DIRECT" : " io_uring") : ""));
+            segmentFilename = path;
+            fileIsOpen = true;
+            return;
+        }
         fileWritePtr = fopen(filename.toStdString().c_str() ,"ab"); // Append mode, for safety.
         if(fileWritePtr == NULL)
         {
@@ -121,14 +165,31 @@ void gpsBinaryLogger::closeFileWriting()
     if(fileIsOpen)
     {
         std::lock_guard<std::mutex>lockfile(fileCloseMutex);
-        if(fileWritePtr != NULL)
+        if(logFile->isOpen())
+        {
+            // Waits for any outstanding writes. A file that was
+            // opened ahead but never written to is not kept.
+            if(rotation.enabled() && !segmentNamed)
+            {
+                lastFileIOError = logFile->remove();
+            } else {
+                int err = finishContainerFile(logFile);
+                int closeErr = logFile->close();
+                lastFileIOError = err ? err : closeErr;
+            }
+            if(nextLogFile->isOpen())
+                nextLogFile->remove();
+            fileIsOpen = false;
+            if(lastFileIOError != 0)
+                emit haveStatusMessage(logRankingStr + QString("Warning, gps binary logger closed file with error %1.").arg(lastFileIOError.load()));
+        } else if(fileWritePtr != NULL)
         {
             int rtnValue = fclose(fileWritePtr);
             fileIsOpen = false;
             //lastFileIOError = ferror(fileWritePtr); // May cause crash after file is closed, do not use
             if(rtnValue != 0)
             {
-                emit haveStatusMessage(logRankingStr + QString("Warning, gps binary logger closed file with status %1 and error %2.").arg(rtnValue).arg(lastFileIOError));
+                emit haveStatusMessage(logRankingStr + QString("Warning, gps binary logger closed file with status %1 and error %2.").arg(rtnValue).arg(lastFileIOError.load()));
             } else {
                 // If the fclose function returns zero, then there is not a file error,
                 // and, any reported error at this point is not meaningful.
@@ -194,7 +255,6 @@ void gpsBinaryLogger::writeBufferToFile()
     if(bufSize)
     {
         amWritingFile = true;
-        QByteArray temp;
         size_t size = 0;
         size_t nWritten = 0;
 
@@ -204,21 +264,21 @@ void gpsBinaryLogger::writeBufferToFile()
 
         for(uint16_t i=0; i < bufSize; i++)
         {
-            temp = buffer.at(i);
+            const gpsTelegramView &temp = buffer.at(i);
             // TESTING ONLY:
             //temp.append(magicId);
             //temp = QByteArray("\xC0\xFF\xEE\xBA\xBE\x00\x00\x44\x44\x88\x88\xDD\xDD", 13);
-            size = temp.size();
+            size = temp.length();
             if(size != 0)
             {
                 if(fileWritePtr != NULL)
                 {
-                    nWritten = fwrite(temp.constData(), size,1,fileWritePtr);
+                    nWritten = fwrite(temp.data(), size,1,fileWritePtr);
                     nWritten = 1;
                     if(nWritten != 1)
                     {
                         lastFileIOError = ferror(fileWritePtr);
-                        emit haveStatusMessage(QString(logRankingStr + "Error, complete GPS byte array not written to file [%1]!! Error number: %2").arg(filename).arg(lastFileIOError));
+                        emit haveStatusMessage(QString(logRankingStr + "Error, complete GPS byte array not written to file [%1]!! Error number: %2").arg(filename).arg(lastFileIOError.load()));
                         emit haveFileIOError(lastFileIOError);
                         // Clear buffer? Self destruct?
                         // Maybe keep the buffer in case the operator fixes the issue, such as a full disk or bad filename
@@ -233,11 +293,12 @@ void gpsBinaryLogger::writeBufferToFile()
         lastFileIOError = ferror(fileWritePtr);
         if(lastFileIOError)
         {
-            emit haveStatusMessage(logRankingStr + QString("Error writing binary GPS data to file [%1]!! Error number: %2").arg(filename).arg(lastFileIOError) );
+            emit haveStatusMessage(logRankingStr + QString("Error writing binary GPS data to file [%1]!! Error number: %2").arg(filename).arg(lastFileIOError.load()) );
             emit haveFileIOError(lastFileIOError);
         }
 
         buffer.clear(); // TODO: Only do this if no errors?
+        // (this also lets go of the receive buffer segments)
 
         amWritingFile = false;
     }
@@ -247,6 +308,12 @@ void gpsBinaryLogger::writeBufferToFile()
 
 
 void gpsBinaryLogger::insertData(QByteArray raw)
+{
+    // For data that did not come from the receive ring.
+    insertData(gpsTelegramView(raw));
+}
+
+void gpsBinaryLogger::insertData(const gpsTelegramView &raw)
 {
     if(closingLogOut)
     {
@@ -260,7 +327,30 @@ void gpsBinaryLogger::insertData(QByteArray raw)
         emit haveStatusMessage(logRankingStr + "Warning, empty data passed to gps logger");
         return;
     }
-    if(loggingAllowed && fileIsOpen)
+    if(loggingAllowed && fileIsOpen && useWriterThread)
+    {
+        messageCount++;
+        gpsQueuedTelegram telegram;
+        telegram.telegram = raw;
+        telegram.receiveTime = (logFormat == logFormatContainer) ? gpsContainer::timeNow() : 0;
+        if(!queue.push(std::move(telegram)))
+        {
+            // The writer has fallen a long way behind. Wait for it
+            // rather than lose data, and keep track of how long for.
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            writerWake.notify_one();
+            while(!queue.push(std::move(telegram)))
+                usleep(200);
+            producerBlockedCount++;
+            producerBlockedMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - t0).count();
+        }
+        size_t queued = queue.size();
+        if(queued > queueHighWater)
+            queueHighWater = queued;
+        if(queued >= writerBatchSize)
+            writerWake.notify_one();
+    } else if(loggingAllowed && fileIsOpen)
     {
         bool waited=false;
         while(amWritingFile)
@@ -286,6 +376,375 @@ void gpsBinaryLogger::insertData(QByteArray raw)
     }
 }
 
+void gpsBinaryLogger::setWriterThreadMode(bool useWriterThread)
+{
+    if(writerRunning)
+    {
+        emit haveStatusMessage(logRankingStr + "Error, cannot change the writer mode while logging.");
+        return;
+    }
+    this->useWriterThread = useWriterThread;
+}
+
+void gpsBinaryLogger::setUringMode(bool useUring, bool directIO)
+{
+    if(fileIsOpen)
+    {
+        emit haveStatusMessage(logRankingStr + "Error, cannot change the io_uring mode while logging.");
+        return;
+    }
+    this->useUring = useUring;
+    this->uringDirectIO = directIO;
+}
+
+void gpsBinaryLogger::startWriterThread()
+{
+    if(writerRunning)
+        return;
+    writerRunning = true;
+    writerThread = std::thread(&gpsBinaryLogger::writerLoop, this);
+}
+
+void gpsBinaryLogger::stopWriterThread()
+{
+    if(!writerRunning)
+        return;
+    writerRunning = false;
+    writerWake.notify_one();
+    writerThread.join();
+}
+
+void gpsBinaryLogger::writerLoop()
+{
+    std::vector<gpsQueuedTelegram> batch;
+    batch.reserve(writerBatchSize);
+    gpsQueuedTelegram telegram;
+
+    while(true)
+    {
+        // Checked before draining, so that everything queued
+        // before the stop request is written:
+        bool running = writerRunning;
+        while((batch.size() < writerBatchSize) && queue.pop(telegram))
+            batch.push_back(std::move(telegram));
+        if(!batch.empty())
+        {
+            writeViews(batch);
+            batch.clear(); // lets go of the receive buffer
+            continue;
+        }
+        if(!running)
+            break;
+        // Sleep until a batch is ready, but not so long that a
+        // trickle of telegrams sits in memory for long.
+        std::unique_lock<std::mutex> lock(writerWakeMutex);
+        writerWake.wait_for(lock, std::chrono::milliseconds(20));
+    }
+}
+
+void gpsBinaryLogger::writeViews(const std::vector<gpsQueuedTelegram> &views)
+{
+    std::lock_guard<std::mutex>lockfile(fileWriteMutex);
+    if(!logFile->isOpen() || views.empty())
+        return;
+
+    // The time since the file was started is the same for the whole batch;
+    // the UTC hour and the size are checked for each telegram, and the
+    // batch split where either runs out:
+    bool timeUp = rotation.enabled() && segmentNamed && segmentTimeUp();
+    size_t first = 0;
+    while(first < views.size())
+    {
+        size_t count = views.size() - first;
+        if(rotation.enabled())
+        {
+            if(segmentNamed && (timeUp || hourChanged(views[first].telegram) || (rotation.maxBytes &&
+                    (logFile->getLength() + recordSize(views[first]) > rotation.maxBytes))))
+            {
+                nextSegment();
+                timeUp = false;
+            }
+            if(!segmentNamed)
+                nameSegment(views[first].telegram);
+            count = segmentRoom(views, first);
+        }
+
+        int err;
+        if(logFormat == logFormatContainer)
+        {
+            container.begin(logFile->getOffset());
+            for(size_t i=first; i < first + count; i++)
+                container.addTelegram(views[i].telegram, views[i].receiveTime);
+            const std::vector<struct iovec> &iov = container.iovecs();
+            err = logFile->append(iov.data(), iov.size());
+        } else {
+            rawIov.resize(count);
+            for(size_t i=0; i < count; i++)
+            {
+                rawIov[i].iov_base = (void*)views[first+i].telegram.data();
+                rawIov[i].iov_len = views[first+i].telegram.length();
+            }
+            err = logFile->append(rawIov.data(), count);
+        }
+        writeCalls++;
+        if(err != 0)
+        {
+            int noError = 0;
+            if(lastFileIOError.compare_exchange_strong(noError, err))
+            {
+                // Only the first error is reported:
+                emit haveStatusMessage(QString(logRankingStr + "Error, complete GPS byte array not written to file [%1]!! Error number: %2")
+                                       .arg(QString::fromStdString(logFile->getPath())).arg(err));
+                emit haveFileIOError(err);
+            }
+            return;
+        }
+        for(size_t i=first; i < first + count; i++)
+            bytesWritten += views[i].telegram.length();
+        first += count;
+    }
+}
+
+void gpsBinaryLogger::splitFilename(QString &stem, QString &suffix)
+{
+    // "/data/gps.log" is "/data/gps" and ".log"
+    int slash = filename.lastIndexOf('/');
+    int dot = filename.lastIndexOf('.');
+    if(dot > slash + 1)
+    {
+        stem = filename.left(dot);
+        suffix = filename.mid(dot);
+    } else {
+        stem = filename;
+        suffix = QString();
+    }
+}
+
+QString gpsBinaryLogger::aheadFilename()
+{
+    QString stem, suffix;
+    splitFilename(stem, suffix);
+    return stem + "_next" + suffix;
+}
+
+uint64_t gpsBinaryLogger::segmentPreallocation()
+{
+    if(!rotation.enabled())
+        return 0;
+    if(rotation.preallocateBytes != 0)
+        return rotation.preallocateBytes;
+    return rotation.maxBytes;
+}
+
+bool gpsBinaryLogger::segmentTimeUp()
+{
+    if(rotation.maxSeconds == 0)
+        return false;
+    std::chrono::steady_clock::duration age = std::chrono::steady_clock::now() - segmentStarted;
+    return age >= std::chrono::seconds(rotation.maxSeconds);
+}
+
+bool gpsBinaryLogger::hourChanged(const gpsTelegramView &telegram)
+{
+    if(!rotation.onUtcHour)
+        return false;
+    gpsMessage m;
+    const decodePlan *plan = NULL;
+    return (gpsBinaryReader::decodeHeader(telegram.data(), telegram.length(), m, &plan) == decodeOK) &&
+            (m.navDataValidityTime / 36000000 != segmentHour);
+}
+
+size_t gpsBinaryLogger::recordSize(const gpsQueuedTelegram &telegram)
+{
+    // Near enough, leaving out the occasional index record:
+    if(logFormat == logFormatContainer)
+        return telegram.telegram.length() + gpsContainer::recordHeaderSize;
+    return telegram.telegram.length();
+}
+
+size_t gpsBinaryLogger::segmentRoom(const std::vector<gpsQueuedTelegram> &views, size_t first)
+{
+    // How many of the telegrams from first on belong in this file, at least one:
+    if((rotation.maxBytes == 0) && !rotation.onUtcHour)
+        return views.size() - first;
+    uint64_t length = logFile->getLength() + recordSize(views[first]);
+    size_t count = 1;
+    while(first + count < views.size())
+    {
+        const gpsQueuedTelegram &next = views[first+count];
+        if((rotation.maxBytes != 0) && (length + recordSize(next) > rotation.maxBytes))
+            break;
+        if(hourChanged(next.telegram))
+            break;
+        length += recordSize(next);
+        count++;
+    }
+    return count;
+}
+
+void gpsBinaryLogger::startContainerFile(gpsLogFile *file)
+{
+    // Adding to an existing container carries on its chain of index records:
+    uint64_t lastIndex = gpsContainer::noOffset;
+    if(file->getOffset() > 0)
+    {
+        lastIndex = gpsLogIndex::lastIndexRecord(file->getPath());
+        if(lastIndex == gpsContainer::noOffset)
+            emit haveStatusMessage(logRankingStr + QString("Warning, adding to [%1], which does not end like a container log.")
+                                   .arg(QString::fromStdString(file->getPath())));
+    }
+    container.reset(lastIndex);
+}
+
+int gpsBinaryLogger::finishContainerFile(gpsLogFile *file)
+{
+    // The last index record, and the end record pointing at it:
+    if((logFormat != logFormatContainer) || !container.started())
+        return 0;
+    uint64_t offset = file->getOffset();
+    container.begin(offset);
+    container.finish(offset);
+    const std::vector<struct iovec> &iov = container.iovecs();
+    return file->append(iov.data(), iov.size());
+}
+
+void gpsBinaryLogger::openAhead()
+{
+    QString path = aheadFilename();
+    int err = nextLogFile->open(path.toStdString(), useUring, uringDirectIO, segmentPreallocation());
+    if((err != 0) && (err != lastAheadError))
+        emit haveStatusMessage(logRankingStr + QString("Warning, cannot open the next log file [%1], error %2.").arg(path).arg(err));
+    lastAheadError = err;
+}
+
+void gpsBinaryLogger::nameSegment(const gpsTelegramView &first)
+{
+    // Name the file after the first telegram in it, for example
+    // gps_c1234567_t134502_5000.log for 13:45:02.5 UTC.
+    QString stem, suffix;
+    splitFilename(stem, suffix);
+    gpsMessage m;
+    const decodePlan *plan = NULL;
+    QString name;
+    if(gpsBinaryReader::decodeHeader(first.data(), first.length(), m, &plan) == decodeOK)
+    {
+        uint32_t t = m.navDataValidityTime; // 100 us since midnight
+        segmentHour = t / 36000000;
+        name = stem + QString("_c%1_t%2%3%4_%5").arg(m.counter)
+                .arg(segmentHour, 2, 10, QChar('0'))
+                .arg((t / 600000) % 60, 2, 10, QChar('0'))
+                .arg((t / 10000) % 60, 2, 10, QChar('0'))
+                .arg(t % 10000, 4, 10, QChar('0')) + suffix;
+    } else {
+        name = stem + QString("_s%1").arg(segmentCount) + suffix;
+    }
+    if(access(name.toStdString().c_str(), F_OK) == 0)
+        name = name.left(name.length() - suffix.length()) + QString("_%1").arg(segmentCount) + suffix;
+
+    int err = logFile->rename(name.toStdString());
+    if(err != 0)
+    {
+        emit haveStatusMessage(logRankingStr + QString("Warning, cannot rename log file to [%1], error %2.").arg(name).arg(err));
+        name = QString::fromStdString(logFile->getPath());
+    } else {
+        emit haveStatusMessage(logRankingStr + QString("Logging to [%1].").arg(name));
+    }
+    {
+        std::lock_guard<std::mutex>lock(segmentNameMutex);
+        segmentFilename = name;
+    }
+    segmentNamed = true;
+
+    // The ahead file can now take the temporary name:
+    if(!nextLogFile->isOpen())
+        openAhead();
+}
+
+void gpsBinaryLogger::nextSegment()
+{
+    if(!nextLogFile->isOpen())
+        openAhead(); // failed before, try again
+    if(!nextLogFile->isOpen())
+        return; // keep writing to this one
+
+    int err = finishContainerFile(logFile);
+    std::swap(logFile, nextLogFile);
+    segmentNamed = false;
+    segmentStarted = std::chrono::steady_clock::now();
+    segmentCount++;
+    if(logFormat == logFormatContainer)
+        startContainerFile(logFile);
+
+    int closeErr = nextLogFile->close();
+    if(err == 0)
+        err = closeErr;
+    if(err != 0)
+        emit haveStatusMessage(logRankingStr + QString("Warning, closed log file [%1] with error %2.")
+                               .arg(QString::fromStdString(nextLogFile->getPath())).arg(err));
+}
+
+void gpsBinaryLogger::setRotation(const gpsLogRotation &rotation)
+{
+    if(fileIsOpen)
+    {
+        emit haveStatusMessage(logRankingStr + "Error, cannot change the log rotation while logging.");
+        return;
+    }
+    if(rotation.enabled() && !useWriterThread)
+        emit haveStatusMessage(logRankingStr + "Warning, log rotation needs the writer thread, and will not happen.");
+    this->rotation = rotation;
+}
+
+void gpsBinaryLogger::setLogFormat(gpsLogFormat format)
+{
+    if(fileIsOpen)
+    {
+        emit haveStatusMessage(logRankingStr + "Error, cannot change the log format while logging.");
+        return;
+    }
+    if((format != logFormatRaw) && !useWriterThread)
+        emit haveStatusMessage(logRankingStr + "Warning, the container format needs the writer thread, writing raw telegrams.");
+    logFormat = format;
+}
+
+void gpsBinaryLogger::setDeviceName(QString device)
+{
+    // The writer thread reads it while logging:
+    if(fileIsOpen)
+        return;
+    container.setDevice(device.toStdString());
+}
+
+uint64_t gpsBinaryLogger::getSegmentCount()
+{
+    return segmentCount;
+}
+
+size_t gpsBinaryLogger::getQueueHighWater()
+{
+    return queueHighWater;
+}
+
+uint64_t gpsBinaryLogger::getProducerBlockedCount()
+{
+    return producerBlockedCount;
+}
+
+uint64_t gpsBinaryLogger::getProducerBlockedMicroseconds()
+{
+    return producerBlockedMicroseconds;
+}
+
+uint64_t gpsBinaryLogger::getWriteCalls()
+{
+    return writeCalls;
+}
+
+uint64_t gpsBinaryLogger::getBytesWritten()
+{
+    return bytesWritten;
+}
+
 uint16_t gpsBinaryLogger::getBufferSize()
 {
     std::lock_guard<std::mutex>lock(bufferSizeMutex);
@@ -321,6 +780,29 @@ void gpsBinaryLogger::debugThis()
     emit haveStatusMessage(QString(logRankingStr + "Debug called in gpsBinaryLogger."));
     emit haveStatusMessage(QString(logRankingStr + "Current filename: %1").arg(filename));
     emit haveStatusMessage(QString(logRankingStr + "Current buffer message count: %1").arg(getBufferSize()));
+    if(useWriterThread)
+    {
+        emit haveStatusMessage(QString(logRankingStr + "Writer queue: %1 of %2 queued, high-water mark %3. Producer blocked %4 times for %5 us in total. %6 bytes in %7 writes.")
+                               .arg(queue.size()).arg(queue.capacity()).arg(queueHighWater)
+                               .arg(producerBlockedCount).arg(producerBlockedMicroseconds)
+                               .arg(getBytesWritten()).arg(getWriteCalls()));
+    }
+    if(useWriterThread && fileIsOpen)
+    {
+        std::lock_guard<std::mutex>lockfile(fileWriteMutex);
+        if(logFile->usesUring())
+        {
+            gpsUringWriter &uring = logFile->uringWriter();
+            emit haveStatusMessage(QString(logRankingStr + "io_uring writer%1: %2 bytes written in %3 submissions, waited on a buffer %4 times.")
+                                   .arg(uring.isDirect() ? " (O_DIRECT)" : "")
+                                   .arg(uring.getBytesWritten()).arg(uring.getSubmissions()).arg(uring.getBufferWaits()));
+        }
+    }
+    if(rotation.enabled())
+    {
+        std::lock_guard<std::mutex>lock(segmentNameMutex);
+        emit haveStatusMessage(QString(logRankingStr + "Current log file: %1, file %2 since logging started.").arg(segmentFilename).arg(segmentCount));
+    }
     emit haveFileIOError(lastFileIOError);
     emit haveFilename(filenameSet);
     emit haveLifetimeMessageCount(messageCount);
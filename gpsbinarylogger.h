@@ -5,11 +5,41 @@
 
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
 
 #include <QObject>
 #include <QByteArray>
 #include <QString>
 
+#include "gpsreceivering.h"
+#include "gpsspscqueue.h"
+#include "gpslogfile.h"
+#include "gpslogcontainer.h"
+
+// When the writer thread starts a new log file. Any combination may be
+// set; with none of them set there is one file, named as given.
+struct gpsLogRotation {
+    uint64_t maxBytes = 0; // file size, 0 for no limit
+    uint32_t maxSeconds = 0; // time since the file was started, 0 for no limit
+    bool onUtcHour = false; // when the navDataValidityTime hour changes
+    uint64_t preallocateBytes = 0; // reserved for each file, 0 to use maxBytes
+
+    bool enabled() const { return (maxBytes != 0) || (maxSeconds != 0) || onUtcHour; }
+};
+
+enum gpsLogFormat {
+    logFormatRaw, // telegrams as received
+    logFormatContainer // records with receive times and an index, see gpsLogContainer
+};
+
+// A telegram waiting for the writer thread:
+struct gpsQueuedTelegram {
+    gpsTelegramView telegram;
+    int64_t receiveTime; // microseconds since the epoch, container format only
+};
 
 class gpsBinaryLogger : public QObject
 {
@@ -28,7 +58,7 @@ class gpsBinaryLogger : public QObject
     bool closingLogOut = false;
     volatile bool isPrimaryLog = false;
     QString logRankingStr;
-    int lastFileIOError = 0;
+    std::atomic<int> lastFileIOError; // set by the writer thread too
     uint16_t idealBufferSize;
     uint64_t messageCount = 0;
 
@@ -39,17 +69,86 @@ class gpsBinaryLogger : public QObject
     std::mutex bufferSetupMutex;
     std::mutex bufferInsertMutex;
 
-    std::vector<QByteArray> buffer;
+    std::vector<gpsTelegramView> buffer;
 
     std::mutex fileWriteMutex;
     std::mutex fileCloseMutex;
     FILE *fileWritePtr = NULL;
     QString filename;
 
+    // Writer thread mode: insertData() only queues the telegram,
+    // and the writer thread writes them out in batches.
+    bool useWriterThread = false;
+    gpsSpscQueue<gpsQueuedTelegram> queue;
+    std::thread writerThread;
+    std::atomic<bool> writerRunning;
+    std::mutex writerWakeMutex;
+    std::condition_variable writerWake;
+    size_t queueHighWater = 0;
+    uint64_t producerBlockedCount = 0;
+    uint64_t producerBlockedMicroseconds = 0;
+    std::atomic<uint64_t> writeCalls;
+    std::atomic<uint64_t> bytesWritten;
+
+    // Files for the writer thread, io_uring if it will open:
+    bool useUring = false;
+    bool uringDirectIO = false;
+    gpsLogFile *logFile;
+    gpsLogFile *nextLogFile; // opened ahead, when rotating
+    gpsLogFormat logFormat = logFormatRaw;
+    gpsContainerWriter container;
+    std::vector<struct iovec> rawIov;
+    void startContainerFile(gpsLogFile *file);
+    int finishContainerFile(gpsLogFile *file);
+
+    // Rotation. Each file is opened ahead under a temporary name, and
+    // renamed after the counter and time of the first telegram in it.
+    gpsLogRotation rotation;
+    bool segmentNamed = false;
+    uint32_t segmentHour = 0;
+    std::chrono::steady_clock::time_point segmentStarted;
+    uint64_t segmentCount = 0;
+    int lastAheadError = 0;
+    std::mutex segmentNameMutex;
+    QString segmentFilename;
+    void splitFilename(QString &stem, QString &suffix);
+    QString aheadFilename();
+    uint64_t segmentPreallocation();
+    bool segmentTimeUp();
+    bool hourChanged(const gpsTelegramView &telegram);
+    size_t recordSize(const gpsQueuedTelegram &telegram);
+    size_t segmentRoom(const std::vector<gpsQueuedTelegram> &views, size_t first);
+    void openAhead();
+    void nameSegment(const gpsTelegramView &first);
+    void nextSegment();
+
+    void startWriterThread();
+    void stopWriterThread();
+    void writerLoop();
+    void writeViews(const std::vector<gpsQueuedTelegram> &views);
+
 
 public:
     gpsBinaryLogger();
     ~gpsBinaryLogger();
+    void insertData(const gpsTelegramView &telegram); // shares the bytes, no copy
+
+    // Set before startLogging():
+    void setWriterThreadMode(bool useWriterThread);
+    void setUringMode(bool useUring, bool directIO); // needs the writer thread
+    void setRotation(const gpsLogRotation &rotation); // needs the writer thread
+    void setLogFormat(gpsLogFormat format); // needs the writer thread
+    void setDeviceName(QString device); // for the container file header
+    uint64_t getSegmentCount(); // files started since startLogging()
+    static const size_t writerQueueSize = 4096; // telegrams, about 20 s at 200 Hz
+    static const size_t writerBatchSize = 256; // telegrams per write
+
+    // Writer thread statistics:
+    size_t getQueueHighWater();
+    uint64_t getProducerBlockedCount();
+    uint64_t getProducerBlockedMicroseconds();
+    uint64_t getWriteCalls();
+    uint64_t getBytesWritten();
 
 
 public slots:
@@ -1,381 +1,499 @@
 #include "gpsbinaryreader.h"
+#include "gpsblocklayout.h"
+#include "gpssimd.h"
+
+// The decoder itself. One of these lives on the stack for each telegram decoded,
+// so that gpsBinaryReader::decode() shares no state between calls.
+class telegramDecoder
+{
+    const uint8_t *rawBytes;
+    size_t rawLength;
+    uint16_t dataPos = 0;
+    bool readOverrun = false;
+    gpsMessage &m;
+
+    void detMsgType();
+    void processNavOutHeaderV2();
+    void processNavOutHeaderV3();
+    void processNavOutHeaderV5();
+    void runDecodePlan(const decodePlan *plan);
+    uint32_t getMessageSum();
+    void setError(gpsDecodeStatus status, dword detail);
+
+    // Helper functions:
+    // These read big-endian values straight out of the telegram:
+    bool haveBytes(size_t startPos, size_t n);
+    unsigned char makeByte(const uint8_t *d, size_t startPos); // unsigned 8 bit int
+    word makeWord(const uint8_t *d, size_t startPos); // unsigned 16 bit int
+    short makeShort(const uint8_t *d, size_t startPos); // signed 16 bit int
+    dword makeDWord(const uint8_t *d, size_t startPos); // unsigned 32 bit int
+    long makeLong(const uint8_t *d, size_t startPos); // signed 32 bit int
+    float makeFloat(const uint8_t *d, size_t startPos); // IEEE 32 bit float
+    double makeDouble(const uint8_t *d, size_t startPos); // IEEE 64 bit float
+
+public:
+    telegramDecoder(const uint8_t *data, size_t length, gpsMessage &m) :
+        rawBytes(data), rawLength(length), m(m) {}
+    gpsDecodeStatus processData(decodePlanCache &cache, const uint32_t *byteSum, const decodePlan **planOut);
+};
+
+static const char *decodeStatusTexts[] = {
+    "NONE",                     // decodeOK
+    "SHORT MSG",                // decodeShortMessage
+    "UNSUPPORTED MSG TYPE",     // decodeUnsupportedType
+    "UNK PROTO",                // decodeUnknownProtocol
+    "UNK Nav Data",             // decodeUnknownNavData
+    "UNK Extended Nav Data",    // decodeUnknownExtendedNavData
+    "BAD Nav Data Size",        // decodeBadNavDataSize
+    "TRUNCATED MSG",            // decodeTruncated
+    "BAD Checksum"              // decodeBadChecksum
+};
+
+static decodePlanCache &threadPlanCache()
+{
+    // Used by callers of the static decoders which bring no cache of their own.
+    static thread_local decodePlanCache cache;
+    return cache;
+}
 
 gpsBinaryReader::gpsBinaryReader()
 {
-    oldCounter = 0;
-    firstRun = true;
-    initialize();
+    memset(&m, 0x0, sizeof(gpsMessage));
 }
 
-gpsBinaryReader::gpsBinaryReader(QByteArray rawData) : rawData(rawData)
+gpsBinaryReader::gpsBinaryReader(const QByteArray &rawData)
+{
+    insertData(rawData);
+}
+
+gpsDecodeStatus gpsBinaryReader::decode(const uint8_t *data, size_t length, gpsMessage &m,
+                                        decodePlanCache *cache, const uint32_t *byteSum)
 {
-    initialize();
-    oldCounter = 0;
-    firstRun = true;
     memset(&m, 0x0, sizeof(gpsMessage));
-    if(rawData.length())
-        processData();
+    if(cache == NULL)
+        cache = &threadPlanCache();
+    telegramDecoder decoder(data, length, m);
+    return decoder.processData(*cache, byteSum, NULL);
 }
 
-void gpsBinaryReader::insertData(QByteArray rawData)
+gpsDecodeStatus gpsBinaryReader::decodeHeader(const uint8_t *data, size_t length, gpsMessage &m,
+                                              const decodePlan **plan, decodePlanCache *cache,
+                                              const uint32_t *byteSum)
 {
-    initialize();
-    this->rawData = rawData;
     memset(&m, 0x0, sizeof(gpsMessage));
-    if(rawData.length())
-        processData();
-    oldCounter = m.counter;
+    if(cache == NULL)
+        cache = &threadPlanCache();
+    telegramDecoder decoder(data, length, m);
+    return decoder.processData(*cache, byteSum, plan);
 }
 
-gpsMessage gpsBinaryReader::getMessage()
+void gpsBinaryReader::decodeValue(unsigned char kind, const uint8_t *d, void *dst)
 {
-    if(!m.validDecode)
+    // Same conversions as the decoder, without the bounds checks.
+    switch(kind)
     {
-        qDebug() << "Warning, returning invalid data with counter " << m.counter;
+    case fieldByte:
+        memcpy(dst, d, 1);
+        break;
+    case fieldWord: {
+        word v = d[1] | (d[0] << 8);
+        memcpy(dst, &v, sizeof(v));
+        break; }
+    case fieldDWord:
+    case fieldFloat:
+        swapBigEndian32(dst, d, 1);
+        break;
+    case fieldLong: {
+        // As makeLong()
+        long v = (long)(int32_t)(((uint32_t)d[0] << 24) | (d[1] << 16) | (d[2] << 8) | d[3]);
+        memcpy(dst, &v, sizeof(v));
+        break; }
+    case fieldDouble: {
+        uint64_t bits = 0;
+        for(int i=0; i < 8; i++)
+        {
+            bits = (bits << 8) | d[i];
+        }
+        memcpy(dst, &bits, sizeof(bits));
+        break; }
+    case fieldQuality: {
+        gpsQualityKinds v = static_cast<gpsQualityKinds>(d[0]);
+        memcpy(dst, &v, sizeof(v));
+        break; }
+    default:
+        break;
     }
-    return m;
 }
 
-void gpsBinaryReader::initialize()
+void gpsBinaryReader::insertData(const QByteArray &rawData)
+{
+    // Thin wrapper around the span decoder. Holding a reference
+    // to the (implicitly shared) array keeps the bytes alive
+    // for the debug functions without making a copy.
+    this->rawData = rawData;
+    decodeRaw((const uint8_t*)this->rawData.constData(), this->rawData.length(), NULL);
+}
+
+void gpsBinaryReader::insertData(const uint8_t *data, size_t length)
 {
-    decodeInvalid = true;
-    dataPos = 0;
-    gpsMessage blank;
-    m = blank; // copy
-    m.counter = 0;
-    // todo: clear out m. m.HaveThings = false;
+    // Decodes directly from the caller's buffer.
+    // The buffer need only remain valid for the duration of this call.
+    rawData.clear();
+    decodeRaw(data, length, NULL);
 }
 
-// Decoder functions:
+void gpsBinaryReader::insertData(const uint8_t *data, size_t length, uint32_t byteSum)
+{
+    // As above, for callers which have already added up the bytes of the
+    // telegram, less the four checksum bytes, for example with copyAndSumBytes().
+    rawData.clear();
+    decodeRaw(data, length, &byteSum);
+}
 
-void gpsBinaryReader::processData()
+void gpsBinaryReader::decodeRaw(const uint8_t *data, size_t length, const uint32_t *byteSum)
 {
-    mtx.lock();
+    gpsDecodeStatus status = decode(data, length, m, &planCache, byteSum);
 
-    copyQStringToCharArray( m.lastDecodeErrorMessage, QString("NONE") );
-    detMsgType();
-    m.protoVers = rawData.at(2);
+    trackSequence(status, m, sequence);
+    if(m.numberDropped)
+    {
+        qDebug() << __PRETTY_FUNCTION__ << "Warning: Dropped " << m.numberDropped << " GPS messages at counter " << m.counter;
+    }
 
-    bool foundErrors = false;
-    m.validDecode = false;
-    decodeInvalid = true;
+    reportDecodeStatus(status);
+}
 
-    if(m.mType != msgIX_outputNav)
+void gpsBinaryReader::trackSequence(gpsDecodeStatus status, gpsMessage &m, gpsSequenceTracker &sequence)
+{
+    switch(status)
     {
-        m.validDecode = false;
-        decodeInvalid = true;
-        copyQStringToCharArray( m.lastDecodeErrorMessage, QString("UNSUPPORTED MSG TYPE") );
-        mtx.unlock();
-        return;
+    case decodeShortMessage:
+    case decodeUnsupportedType:
+    case decodeUnknownProtocol:
+    case decodeBadNavDataSize:
+        // The data blocks were not decoded, don't count this one.
+        sequence.resync(m.counter);
+        break;
+    default:
+        m.numberDropped = sequence.update(m.counter);
+        break;
     }
+}
 
-    dataPos = 3;
+int gpsBinaryReader::telegramLength(const uint8_t *data, size_t available)
+{
+    // Looks at the header of the telegram starting at data.
+    // Returns the total telegram size, 0 if more bytes are needed to tell,
+    // or -1 if this is not the start of an IX telegram.
+    if(available < 3)
+        return 0;
+    if(data[0] != 'I' || data[1] != 'X')
+        return -1;
 
-    switch(m.protoVers)
+    size_t sizePos = 0;
+    size_t headerSize = 0;
+    switch(data[2])
     {
     case 2:
-        processNavOutHeaderV2();
+        sizePos = 11;
+        headerSize = 21;
         break;
     case 3:
-        processNavOutHeaderV3();
+        sizePos = 15;
+        headerSize = 25;
         break;
     case 5:
-        processNavOutHeaderV5();
+        sizePos = 17;
+        headerSize = 27;
         break;
     default:
-        // Invalid data
-        m.validDecode = false;
-        decodeInvalid = true;
-        copyQStringToCharArray( m.lastDecodeErrorMessage, QString("UNK PROTO  ") );
-        mtx.unlock();
-        return;
-        break;
+        return -1;
     }
+    if(available < sizePos + 2)
+        return 0;
 
-    // These must be called in a specific order,
-    // since the offset into the message is dependant upon
-    // how many blocks of data have been read.
+    size_t size = data[sizePos+1] | (data[sizePos] << 8);
+    if((size < headerSize + 4) || (size > maxTelegramSize))
+        return -1;
+    return size;
+}
 
-    if(getBit(m.navDataBlockBitmask, 0))
-    {
-        //qDebug() << "Have Altitude and Heading Data";
-        processAltitudeHeadingData();
-    }
-    if(getBit(m.navDataBlockBitmask, 1))
-    {
-        //qDebug() << "Have Alt and Head Std Dev";
-        processAltitudeHeadingStdDevData();
-    }
-    // Mystery data at bits 2 and 3:
-    if(getBit(m.navDataBlockBitmask, 2))
-    {
-        processRealTimeHeaveSurgeSwayData();
-    }
-    if(getBit(m.navDataBlockBitmask, 3))
-    {
-        processSmartHeaveData();
-    }
+size_t gpsBinaryReader::decodeBatch(const uint8_t *data, size_t length,
+                                    gpsMessage *messages, gpsDecodeStatus *statuses, size_t maxMessages,
+                                    size_t *bytesUsed, decodePlanCache *cache, gpsSequenceTracker *sequence)
+{
+    size_t pos = 0;
+    size_t count = 0;
 
-    if(getBit(m.navDataBlockBitmask, 4))
-    {
-        //qDebug() << "Have Heading RollPitchRate";
-        processHeadingRollPitchRateData();
-    }
-    if(getBit(m.navDataBlockBitmask, 5))
-    {
-        //qDebug() << "Have Body Rotation Rate";
-        processBodyRotationRate();
-    }
-    if(getBit(m.navDataBlockBitmask, 6))
-    {
-        //qDebug() << "Have acceleration data";
-        processAccelerationData();
-    }
-    if(getBit(m.navDataBlockBitmask, 7))
-    {
-        //qDebug() << "Have Position Data!";
-        processPositionData();
-    }
-    if(getBit(m.navDataBlockBitmask, 8))
-    {
-        //qDebug() << "Have Position StdDev Data!";
-        processPositionStdDevData();
-    }
-    if(getBit(m.navDataBlockBitmask, 9))
-    {
-        //qDebug() << "Have Speed Data!";
-        processSpeedData();
-    }
-    if(getBit(m.navDataBlockBitmask, 10))
-    {
-        //qDebug() << "Have Speed Standard Deviation Data";
-        processSpeedStdDevData();
-    }
-    if(getBit(m.navDataBlockBitmask, 11))
-    {
-        //qDebug() << "Have ocean current data";
-        processCurrentData();
-    }
-    if(getBit(m.navDataBlockBitmask, 12))
-    {
-        //qDebug() << "Have ocean current std dev data";
-        processCurrentStdDevData();
-    }
-    if(getBit(m.navDataBlockBitmask, 13))
-    {
-        //qDebug() << "Have System Date data";
-        processSystemDateData();
-    }
-    if(getBit(m.navDataBlockBitmask, 14 ))
-    {
-        //qDebug() << "Have INS Sensor Status";
-        processINSSensorStatus();
-    }
-    if(getBit(m.navDataBlockBitmask, 15))
-    {
-        //qDebug() << "Have INS Algorithm Status";
-        processINSAlgorithmStatus();
-    }
-    if(getBit(m.navDataBlockBitmask, 16))
-    {
-        //qDebug() << "Have INS System Status";
-        processINSSystemStatus();
-    }
-    if(getBit(m.navDataBlockBitmask, 17))
+    while((count < maxMessages) && (pos < length))
     {
-        //qDebug() << "Have INS User Status";
-        processINSUserStatus();
-    }
+        int size = telegramLength(data + pos, length - pos);
+        if(size < 0)
+        {
+            // Not a telegram, look for the next one.
+            const uint8_t *next = findBytePair(data + pos + 1, length - pos - 1, 'I', 'X');
+            if(next != NULL)
+                pos = next - data;
+            else
+                pos = (data[length-1] == 'I') ? length - 1 : length; // may be the start of one
+            continue;
+        }
+        if((size == 0) || (pos + size > length))
+        {
+            // Incomplete telegram at the end of the buffer.
+            break;
+        }
 
-    // Mystery data at Bit 21:
-    if(getBit(m.navDataBlockBitmask, 21))
-    {
-        //qDebug() << "Have Mystery Data at Nav Bit 21!";
-        processHeaveSurgeSwaySpeed();
-    }
+        gpsDecodeStatus status = decode(data + pos, size, messages[count], cache);
+        statuses[count] = status;
+        if(sequence != NULL)
+            trackSequence(status, messages[count], *sequence);
+        count++;
 
-    if(getBit(m.navDataBlockBitmask, 22))
-    {
-        //qDebug() << "Have vessel speed data";
-        processVesselVelocity();
-    }
-    if(getBit(m.navDataBlockBitmask, 23))
-    {
-        //qDebug() << "Have accel geographic frame";
-        processAccelGeographic();
-    }
-    if(getBit(m.navDataBlockBitmask, 24))
-    {
-        //qDebug() << "Have course and speed over ground";
-        processCourseSpeedGround();
-    }
-    if(getBit(m.navDataBlockBitmask, 25))
-    {
-        //qDebug() << "Have Temperatures (of system)";
-        processTemperature();
-    }
-    if(getBit(m.navDataBlockBitmask, 26))
-    {
-        //qDebug() << "Have attitude quaternion";
-        processAttitudeQuaternion();
-    }
-    if(getBit(m.navDataBlockBitmask, 27))
-    {
-        //qDebug() << "Have attitude quaternion std dev";
-        processAttitudeQuaternationStdDev();
-    }
-    if(getBit(m.navDataBlockBitmask, 28))
-    {
-        //qDebug() << "Have raw accel in vessel frame";
-        processVesselAccel();
-    }
-    if(getBit(m.navDataBlockBitmask, 29))
-    {
-        //qDebug() << "Have acceleration std dev in vessel frame";
-        processVesselAccelStdDev();
-    }
-    if(getBit(m.navDataBlockBitmask, 30))
-    {
-        //qDebug() << "Have vessel rotation rate std dev";
-        processVesselRotationRateStdDev();
+        if(status == decodeOK)
+        {
+            pos += size;
+        } else {
+            // Perhaps this was not a telegram after all, so search from just after the sync bytes.
+            pos += 2;
+        }
     }
 
+    if(bytesUsed != NULL)
+        *bytesUsed = pos;
+    return count;
+}
 
-    // exteNDED Nav Data Blocks:
+size_t gpsBinaryReader::decodeBatch(const uint8_t *data, size_t length,
+                                    std::vector<gpsMessage> &messages, std::vector<gpsDecodeStatus> &statuses,
+                                    size_t maxMessages, size_t *bytesUsed,
+                                    decodePlanCache *cache, gpsSequenceTracker *sequence)
+{
+    // The vectors are sized to hold the results, their storage is reused
+    // from one call to the next.
+    messages.resize(maxMessages);
+    statuses.resize(maxMessages);
+    size_t count = decodeBatch(data, length, messages.data(), statuses.data(), maxMessages,
+                               bytesUsed, cache, sequence);
+    messages.resize(count);
+    statuses.resize(count);
+    return count;
+}
 
-    if( (m.extendedNavDataBlockBitmask != 0x00000007) && ( m.extendedNavDataBlockBitmask!= 0x00000000) )
+void gpsBinaryReader::reportDecodeStatus(gpsDecodeStatus status)
+{
+    switch(status)
     {
-        foundErrors = true;
-        decodeInvalid = true;
-        m.validDecode = false;
-        copyQStringToCharArray( m.lastDecodeErrorMessage, QString("UNK Extended Nav Data  ") );
+    case decodeOK:
+        return;
+    case decodeUnknownNavData:
+        qDebug() << "WARNING: Invalid decode at count " << m.counter << ", unknown nav data found: " << QString("0x%1").arg(m.navDataBlockBitmask, 8, 16, QChar('0'));
+        break;
+    case decodeUnknownExtendedNavData:
         qDebug() << "WARNING: Invalid decode at count " << m.counter << ", extended nav data found: " << QString("0x%1").arg(m.extendedNavDataBlockBitmask, 8, 16, QChar('0'));
+        break;
+    case decodeBadNavDataSize:
+        qDebug() << "WARNING: Invalid decode at count " << m.counter << ", nav data size " << m.navigationDataSize << " does not match bitmasks.";
+        return;
+    case decodeTruncated:
+        qDebug() << "Warning: message with counter " << m.counter << " is shorter than its data blocks.";
+        break;
+    case decodeBadChecksum:
+        qDebug() << "Warning: invalid checksum in message with counter " << m.counter << ", message checksum: " << m.claimedMessageSum << ", calculated checksum: " << m.calculatedChecksum;
+        break;
+    default:
+        // Nothing decoded worth mentioning.
+        return;
     }
+    qDebug() << "Found errors at counter: " << m.counter;
+}
 
-    if(getBit(m.extendedNavDataBlockBitmask, 0))
+gpsMessage gpsBinaryReader::getMessage()
+{
+    if(!m.validDecode)
     {
-        processExtendedRotationAccelData();
+        qDebug() << "Warning, returning invalid data with counter " << m.counter;
     }
-    if(getBit(m.extendedNavDataBlockBitmask, 1))
+    return m;
+}
+
+gpsDecodeStatus gpsBinaryReader::getDecodeStatus()
+{
+    return m.decodeStatus;
+}
+
+const char *gpsBinaryReader::decodeStatusText(gpsDecodeStatus status)
+{
+    if((unsigned int)status >= sizeof(decodeStatusTexts)/sizeof(decodeStatusTexts[0]))
+        return "UNKNOWN";
+    return decodeStatusTexts[status];
+}
+
+QString gpsBinaryReader::decodeErrorString(const gpsMessage &m)
+{
+    // Only built when something is going to show it.
+    QString s(decodeStatusText(m.decodeStatus));
+    switch(m.decodeStatus)
     {
-        processExtendedRotationAccelStdDevData();
+    case decodeOK:
+        break;
+    case decodeUnsupportedType:
+    case decodeUnknownNavData:
+    case decodeUnknownExtendedNavData:
+    case decodeBadChecksum:
+        s += QString(" 0x%1").arg(m.decodeErrorDetail, 8, 16, QChar('0'));
+        break;
+    default:
+        s += QString(" %1").arg(m.decodeErrorDetail);
+        break;
     }
-    if(getBit(m.extendedNavDataBlockBitmask, 2))
+    return s;
+}
+
+// Sequence tracking:
+
+uint32_t gpsSequenceTracker::update(uint32_t counter)
+{
+    uint32_t dropped = 0;
+    if(firstRun)
     {
-        processExtendedRawRotationRateData();
+        firstRun = false;
+    } else {
+        if(oldCounter+1 != counter)
+        {
+            dropped = counter-oldCounter;
+        }
     }
+    oldCounter = counter;
+    return dropped;
+}
+
+void gpsSequenceTracker::resync(uint32_t counter)
+{
+    oldCounter = counter;
+}
 
+void gpsSequenceTracker::reset()
+{
+    firstRun = true;
+    oldCounter = 0;
+}
+
+// Decoder functions:
 
-    // exteRNAL sensor data blocks.
+gpsDecodeStatus telegramDecoder::processData(decodePlanCache &cache, const uint32_t *byteSum,
+                                             const decodePlan **planOut)
+{
+    gpsDecodeStatus status = decodeOK;
 
-    if(getBit(m.externDataBitMask, 0))
-    {
-        // UTC
-        processUTC();
-    }
-    if(getBit(m.externDataBitMask, 1))
+    if(planOut != NULL)
+        *planOut = NULL;
+
+    m.validDecode = false;
+
+    if(rawBytes == NULL || rawLength < 3)
     {
-        // GNSS 1 status
-        processGNSS(1);
-        m.haveGNSSInfo1 = true;
+        setError(decodeShortMessage, rawLength);
+        return decodeShortMessage;
     }
-    if(getBit(m.externDataBitMask, 2))
+
+    detMsgType();
+    m.protoVers = rawBytes[2];
+
+    if(m.mType != msgIX_outputNav)
     {
-        // GNSS 2 status
-        processGNSS(2);
-        m.haveGNSSInfo2 = true;
+        setError(decodeUnsupportedType, rawBytes[0] | (rawBytes[1] << 8));
+        return decodeUnsupportedType;
     }
-    if(getBit(m.externDataBitMask, 3))
+
+    dataPos = 3;
+
+    switch(m.protoVers)
     {
-        // GNSS Manual status "3"
-        processGNSS(3);
-        m.haveGNSSInfo3 = true;
+    case 2:
+        processNavOutHeaderV2();
+        break;
+    case 3:
+        processNavOutHeaderV3();
+        break;
+    case 5:
+        processNavOutHeaderV5();
+        break;
+    default:
+        // Invalid data
+        setError(decodeUnknownProtocol, (unsigned char)m.protoVers);
+        return decodeUnknownProtocol;
+        break;
     }
 
+    // Each block's position in the telegram follows from the bitmasks
+    // alone (see gpsblocklayout.h), so the bitmasks can be checked
+    // against the claimed data size before any block is read.
 
-
-    if(firstRun)
+    if(m.navDataBlockBitmask & ~navDataKnownMask)
     {
-        firstRun = false;
-    } else {
-        if(oldCounter+1 != m.counter)
-        {
-            qDebug() << __PRETTY_FUNCTION__ << "Warning: Dropped " << m.counter-oldCounter << " GPS messages at counter " << m.counter;
-            m.numberDropped = m.counter-oldCounter;
-        } else {
-            m.numberDropped = 0;
-        }
+        status = decodeUnknownNavData;
+        setError(status, m.navDataBlockBitmask);
     }
 
-    getMessageSum();
-
-    uint32_t oldPos = dataPos; // retain previous position in case it is needed later.
-    m.claimedMessageSum = makeDWord(rawData, rawData.length() - 4);
+    if( (m.extendedNavDataBlockBitmask != 0x00000007) && ( m.extendedNavDataBlockBitmask!= 0x00000000) )
+    {
+        status = decodeUnknownExtendedNavData;
+        setError(status, m.extendedNavDataBlockBitmask);
+    }
 
-    (void)oldPos;
+    const decodePlan *plan = cache.find(m.navDataBlockBitmask, m.extendedNavDataBlockBitmask,
+                                        m.externDataBitMask, dataPos);
 
-    if(m.claimedMessageSum != messageSum)
+    if( (m.protoVers == 5) && (status == decodeOK) && (plan->navigationDataSize != m.navigationDataSize) )
     {
-        copyQStringToCharArray( m.lastDecodeErrorMessage, QString("BAD Checksum  ") );
-        qDebug() << "Warning: invalid checksum in message with counter " << m.counter << ", message checksum: " << m.claimedMessageSum << ", calculated checksum: " << messageSum;
-        decodeInvalid = true;
-        m.validDecode = false;
-        foundErrors = true;
+        setError(decodeBadNavDataSize, m.navigationDataSize);
+        return decodeBadNavDataSize;
     }
 
-    // A little debug checking:
-//    if(m.navDataBlockBitmask != 0x7fe3ffff)
-//    {
-//        qDebug() << "Navigation data block bitmask: counter = " << m.counter;
-//        printBinary(m.navDataBlockBitmask);
-//    }
-
-//    if(m.extendedNavDataBlockBitmask != 0x00000007)
-//    {
-//        qDebug() << "Extended data block bitmask: counter = " << m.counter;
-//        printBinary(m.extendedNavDataBlockBitmask);
-//    }
+    if(plan->dataEnd > rawLength)
+        readOverrun = true;
 
-//    if(m.externDataBitMask != 0)
-//    {
-//        qDebug() << "External sensor bitmask: counter = " << m.counter;
-//        printBinary(m.externDataBitMask);
-//        printMessage();
+    // Without planOut the blocks are decoded into m, otherwise
+    // the caller decodes the fields it wants from the plan.
+    if(planOut != NULL)
+        *planOut = plan;
+    else
+        runDecodePlan(plan);
 
-//    }
+    m.calculatedChecksum = byteSum ? *byteSum : getMessageSum();
+    m.claimedMessageSum = makeDWord(rawBytes, rawLength - 4);
 
-    // HERE is where we place the final Good / No-Good into the message:
-    if(foundErrors)
+    if(readOverrun)
     {
-        qDebug() << "Found errors at counter: " << m.counter;
-        m.validDecode = false;
-        decodeInvalid = true;
-    } else {
-        //qDebug() << "Did not find errors at counter: " << m.counter;
-        m.validDecode = true;
-        decodeInvalid = false;
+        status = decodeTruncated;
+        setError(status, rawLength);
     }
 
-    // DEBUG for AV3 testing:
-    if(m.haveINSAlgorithmStatus)
+    if(m.claimedMessageSum != m.calculatedChecksum)
     {
-        if(priorAlgorithmStatus1 != m.algorithmStatus1)
-        {
-            //qDebug() << "Changed algorithmStatus bits.";
-            //printAlgorithmStatusMessages(m);
-            priorAlgorithmStatus1 = m.algorithmStatus1;
-        }
+        status = decodeBadChecksum;
+        setError(status, m.claimedMessageSum);
     }
 
-    mtx.unlock();
+    // HERE is where we place the final Good / No-Good into the message:
+    m.validDecode = (status == decodeOK);
 
+    return status;
+}
+
+void telegramDecoder::setError(gpsDecodeStatus status, dword detail)
+{
+    // The last error found is the one kept in the message.
+    m.decodeStatus = status;
+    m.decodeErrorDetail = detail;
 }
 
-void gpsBinaryReader::detMsgType()
+void telegramDecoder::detMsgType()
 {
     unsigned int messageType = 0;
 
-    messageType = rawData.at(0) | (rawData.at(1) << 8);
+    messageType = rawBytes[0] | (rawBytes[1] << 8);
 
     switch(messageType)
     {
@@ -398,345 +516,188 @@ void gpsBinaryReader::detMsgType()
     }
 }
 
-void gpsBinaryReader::processNavOutHeaderV2()
+void telegramDecoder::processNavOutHeaderV2()
 {
-    m.navDataBlockBitmask = makeDWord(rawData, dataPos);
-    m.externDataBitMask = makeDWord(rawData, dataPos);
-    m.totalTelegramSize = makeWord(rawData, dataPos);
-    m.navDataValidityTime = makeDWord(rawData, dataPos);
-    m.counter = makeDWord(rawData, dataPos);
+    m.navDataBlockBitmask = makeDWord(rawBytes, dataPos);
+    m.externDataBitMask = makeDWord(rawBytes, dataPos);
+    m.totalTelegramSize = makeWord(rawBytes, dataPos);
+    m.navDataValidityTime = makeDWord(rawBytes, dataPos);
+    m.counter = makeDWord(rawBytes, dataPos);
 }
 
-void gpsBinaryReader::processNavOutHeaderV3()
+void telegramDecoder::processNavOutHeaderV3()
 {
-    m.navDataBlockBitmask = makeDWord(rawData, dataPos);
-    m.extendedNavDataBlockBitmask = makeDWord(rawData, dataPos);
-    m.externDataBitMask = makeDWord(rawData, dataPos);
+    m.navDataBlockBitmask = makeDWord(rawBytes, dataPos);
+    m.extendedNavDataBlockBitmask = makeDWord(rawBytes, dataPos);
+    m.externDataBitMask = makeDWord(rawBytes, dataPos);
 
-    m.totalTelegramSize = makeWord(rawData, dataPos);
-    m.navDataValidityTime = makeDWord(rawData, dataPos);
-    m.counter = makeDWord(rawData, dataPos);
+    m.totalTelegramSize = makeWord(rawBytes, dataPos);
+    m.navDataValidityTime = makeDWord(rawBytes, dataPos);
+    m.counter = makeDWord(rawBytes, dataPos);
 }
 
-void gpsBinaryReader::processNavOutHeaderV5()
+void telegramDecoder::processNavOutHeaderV5()
 {
-    m.navDataBlockBitmask = makeDWord(rawData, dataPos);
-    m.extendedNavDataBlockBitmask = makeDWord(rawData, dataPos);
-    m.externDataBitMask = makeDWord(rawData, dataPos);
-    m.navigationDataSize = makeWord(rawData, dataPos);
-    m.totalTelegramSize = makeWord(rawData, dataPos);
-    m.navDataValidityTime = makeDWord(rawData, dataPos);
-    m.counter = makeDWord(rawData, dataPos);
+    m.navDataBlockBitmask = makeDWord(rawBytes, dataPos);
+    m.extendedNavDataBlockBitmask = makeDWord(rawBytes, dataPos);
+    m.externDataBitMask = makeDWord(rawBytes, dataPos);
+    m.navigationDataSize = makeWord(rawBytes, dataPos);
+    m.totalTelegramSize = makeWord(rawBytes, dataPos);
+    m.navDataValidityTime = makeDWord(rawBytes, dataPos);
+    m.counter = makeDWord(rawBytes, dataPos);
     //qDebug() << "Counter: " << m.counter;
 }
 
-void gpsBinaryReader::processAltitudeHeadingData()
-{
-    // Bit 0
-    //qDebug() << "alt heading data at pos: " << dataPos;
-    m.heading = makeFloat(rawData, dataPos);
-    m.roll = makeFloat(rawData, dataPos);
-    m.pitch = makeFloat(rawData, dataPos);
-    m.haveAltitudeHeading = true;
-}
-
-void gpsBinaryReader::processAltitudeHeadingStdDevData()
-{
-    // Bit 1
-    //qDebug() << "alt heading data stddev at pos: " << dataPos;
-    m.headingStardardDeviation = makeFloat(rawData, dataPos);
-    m.rollStandardDeviation = makeFloat(rawData, dataPos);
-    m.pitchStandardDeviation = makeFloat(rawData, dataPos);
-    m.haveAltitudeHeadingStdDev = true;
-}
-
-void gpsBinaryReader::processRealTimeHeaveSurgeSwayData()
-{
-    // Bit 2, RealTimeHeaveSurgeSway data
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.rt_heave_withoutBdL = makeFloat(rawData, dataPos); /*! Meters - positive UP in horizontal vehicle frame */
-    m.rt_heave_atBdL = makeFloat(rawData, dataPos);      /*! Meters - positive UP in horizontal vehicle frame */
-    m.rt_surge_atBdL = makeFloat(rawData, dataPos); /*! Meters - positive FORWARD in horizontal vehicle frame */
-    m.rt_sway_atBdL = makeFloat(rawData, dataPos);  /*! Meters - positive PORT SIDE in horizontal vehicle frame */
-    m.haveRealTimeHeaveSurgeSwayData = true;
-}
-
-void gpsBinaryReader::processSmartHeaveData()
-{
-    // Bit 3, Smart Heave
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.smartHeaveValidityTime_100us = makeDWord(rawData, dataPos);
-    m.smartHeave_m = makeDWord(rawData, dataPos);
-    m.haveSmartHeaveData = true;
-}
-
-void gpsBinaryReader::processHeadingRollPitchRateData()
-{
-    // Bit 4
-    //qDebug() << "heading roll pitch rate at pos: " << dataPos;
-    m.headingRotationRate = makeFloat(rawData, dataPos);
-    m.rollRotationRate = makeFloat(rawData, dataPos);
-    m.pitchRotationRate = makeFloat(rawData, dataPos);
-    m.haveHeadingRollPitchRate = true;
-}
-
-void gpsBinaryReader::processBodyRotationRate()
-{
-    // Bit 5
-    //qDebug() << "heading roll pitch rotation rate at pos: " << dataPos;
-    m.rotationRateXV1 = makeFloat(rawData, dataPos);
-    m.rotationRateXV2 = makeFloat(rawData, dataPos);
-    m.rotationRateXV3 = makeFloat(rawData, dataPos);
-    m.haveBodyRotationRate = true;
-}
-
-void gpsBinaryReader::processAccelerationData()
-{
-    // Bit 6
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.accelXV1 = makeFloat(rawData, dataPos);
-    m.accelXV2 = makeFloat(rawData, dataPos);
-    m.accelXV3 = makeFloat(rawData, dataPos);
-    m.haveAccel = true;
-}
-
-void gpsBinaryReader::processPositionData()
-{
-    // Bit 7
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.latitude = makeDouble(rawData, dataPos);
-    m.longitude = makeDouble(rawData, dataPos);
-    //qDebug() << "Lat: " << m.latitude << ", long: " << m.longitude;
-    m.altitudeReference = rawData.at(dataPos); dataPos++;
-    m.altitude = makeFloat(rawData, dataPos);
-    m.havePosition = true;
-}
-
-void gpsBinaryReader::processPositionStdDevData()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.northStdDev = makeFloat(rawData, dataPos);
-    m.eastStdDev = makeFloat(rawData, dataPos);
-    m.neCorrelation = makeFloat(rawData, dataPos);
-    m.altitudStdDev = makeFloat(rawData, dataPos);
-    m.havePositionStdDev = true;
-}
-
-void gpsBinaryReader::processSpeedData()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.northVelocity = makeFloat(rawData, dataPos);
-    m.eastVelocity = makeFloat(rawData, dataPos);
-    m.upVelocity = makeFloat(rawData, dataPos);
-    m.haveSpeedData = true;
-}
-
-void gpsBinaryReader::processSpeedStdDevData()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.northVelocityStdDev = makeFloat(rawData, dataPos);
-    m.eastVelocityStdDev = makeFloat(rawData, dataPos);
-    m.upVelocityStdDev = makeFloat(rawData, dataPos);
-    m.haveSpeedStdDev = true;
-}
-
-void gpsBinaryReader::processCurrentData()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.northCurrent = makeFloat(rawData, dataPos);
-    m.eastCurrent = makeFloat(rawData, dataPos);
-    m.haveCurrentData = true;
-}
-
-void gpsBinaryReader::processCurrentStdDevData()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.northCurrentStdDev = makeFloat(rawData, dataPos);
-    m.eastCurrentStdDev = makeFloat(rawData, dataPos);
-    m.haveCurrentData = true;
-}
-
-void gpsBinaryReader::processSystemDateData()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.systemDay = (unsigned char)rawData.at(dataPos); dataPos++;
-    m.systemMonth = (unsigned char)rawData.at(dataPos); dataPos++;
-    m.systemYear = makeWord(rawData, dataPos);
-    m.haveSystemDateData = true;
-}
-
-void gpsBinaryReader::processINSSensorStatus()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.insSensorStatus1 = makeDWord(rawData, dataPos);
-    m.insSensorStatus2 = makeDWord(rawData, dataPos);
-    m.haveINSSensorStatus = true;
-}
-
-void gpsBinaryReader::processINSAlgorithmStatus()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.algorithmStatus1 = makeDWord(rawData, dataPos);
-    m.algorithmStatus2 = makeDWord(rawData, dataPos);
-    m.algorithmStatus3 = makeDWord(rawData, dataPos);
-    m.algorithmStatus4 = makeDWord(rawData, dataPos);
-    m.haveINSAlgorithmStatus = true;
-}
-
-void gpsBinaryReader::processINSSystemStatus()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.systemStatus1 = makeDWord(rawData, dataPos);
-    m.systemStatus2 = makeDWord(rawData, dataPos);
-    m.systemStatus3 = makeDWord(rawData, dataPos);
-    m.haveINSSystemStatus = true;
-}
-
-void gpsBinaryReader::processINSUserStatus()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.INSuserStatus = makeDWord(rawData, dataPos);
-    m.haveINSUserStatus = true;
-}
-
-void gpsBinaryReader::processHeaveSurgeSwaySpeed()
-{
-    // Bit 21:
-    m.realtime_heave_speed = makeFloat(rawData, dataPos);
-    m.surge_speed = makeFloat(rawData, dataPos);
-    m.sway_speed = makeFloat(rawData, dataPos);
-    m.haveHeaveSurgeSwaySpeedData = true;
-}
-
-void gpsBinaryReader::processVesselVelocity()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.vesselXV1Velocity = makeFloat(rawData, dataPos);
-    m.vesselXV2Velocity = makeFloat(rawData, dataPos);
-    m.vesselXV3Velocity = makeFloat(rawData, dataPos);
-    m.haveSpeedVesselData = true;
-}
-
-void gpsBinaryReader::processAccelGeographic()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.geographicNorthAccel = makeFloat(rawData, dataPos);
-    m.geographicEastAccel = makeFloat(rawData, dataPos);
-    m.geographicVertAccel = makeFloat(rawData, dataPos);
-    m.haveAccelGeographicData = true;
-}
-
-void gpsBinaryReader::processCourseSpeedGround()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.courseOverGround = makeFloat(rawData, dataPos);
-    m.speedOverGround = makeFloat(rawData, dataPos);
-    m.haveCourseSpeedGroundData = true;
-}
-
-void gpsBinaryReader::processTemperature()
-{
-    //qDebug() << __PRETTY_FUNCTION__ << dataPos;
-    m.meanTempFOG = makeFloat(rawData, dataPos);
-    m.meanTempACC = makeFloat(rawData, dataPos);
-    m.meanTempSensor = makeFloat(rawData, dataPos);
-    m.haveTempData = true;
-    //qDebug() << "FOG temp: " << m.meanTempFOG << ", ACC temp: " << m.meanTempACC << ", Sensor temp: " << m.meanTempSensor;
-}
+// Decode plans:
 
-void gpsBinaryReader::processAttitudeQuaternion()
+static uint16_t addBlocksToPlan(decodePlan &plan, const blockLayout *table, dword bitmask, uint16_t startPos)
 {
-    m.attitudeQCq0 = makeFloat(rawData, dataPos);
-    m.attitudeQCq1 = makeFloat(rawData, dataPos);
-    m.attitudeQCq2 = makeFloat(rawData, dataPos);
-    m.attitudeQCq3 = makeFloat(rawData, dataPos);
-    m.haveAttitudeQuaternionData = true;
+    // Blocks are packed in the telegram in order of bit number:
+    while(bitmask)
+    {
+        const blockLayout &block = table[__builtin_ctz(bitmask)];
+        for(int i=0; i < block.fieldCount; i++)
+        {
+            decodePlanOp op;
+            op.srcOffset = startPos + block.fields[i].srcOffset;
+            op.dstOffset = block.fields[i].dstOffset;
+            op.count = 1;
+            op.kind = block.fields[i].kind;
+
+            // Fields that are 32-bit words both in the telegram and in gpsMessage,
+            // and which follow on from the previous field in both, are swapped as one run:
+            bool is32 = (op.kind == fieldFloat) || (op.kind == fieldDWord);
+            if(is32 && !plan.ops.empty())
+            {
+                decodePlanOp &last = plan.ops.back();
+                bool last32 = (last.kind == fieldFloat) || (last.kind == fieldDWord) || (last.kind == fieldRun32);
+                if(last32 && (last.srcOffset + 4*last.count == op.srcOffset) &&
+                        (last.dstOffset + 4*last.count == op.dstOffset))
+                {
+                    last.kind = fieldRun32;
+                    last.count++;
+                    continue;
+                }
+            }
+            plan.ops.push_back(op);
+        }
+        startPos += block.sizeBytes;
+        bitmask &= bitmask - 1;
+    }
+    return startPos;
 }
 
-void gpsBinaryReader::processAttitudeQuaternationStdDev()
+const decodePlan *decodePlanCache::find(dword navDataBlockBitmask, dword extendedNavDataBlockBitmask,
+                                        dword externDataBitMask, uint16_t headerSize)
 {
-    m.attitudeQE1 = makeFloat(rawData, dataPos);
-    m.attitudeQE2 = makeFloat(rawData, dataPos);
-    m.attitudeQE3 = makeFloat(rawData, dataPos);
-    m.haveAttitudeQEData = true;
-}
+    // Telegrams from a unit only ever use a handful of bitmask combinations,
+    // so the list of fields to decode is worked out once per combination.
+    for(size_t i=0; i < plans.size(); i++)
+    {
+        size_t n = (lastPlanIndex + i) % plans.size();
+        const decodePlan &p = plans[n];
+        if( (p.navDataBlockBitmask == navDataBlockBitmask) &&
+                (p.extendedNavDataBlockBitmask == extendedNavDataBlockBitmask) &&
+                (p.externDataBitMask == externDataBitMask) &&
+                (p.headerSize == headerSize) )
+        {
+            lastPlanIndex = n;
+            hits++;
+            return &p;
+        }
+    }
 
-void gpsBinaryReader::processVesselAccel()
-{
-    m.vesselAccelXV1 = makeFloat(rawData, dataPos);
-    m.vesselAccelXV2 = makeFloat(rawData, dataPos);
-    m.vesselAccelXV3 = makeFloat(rawData, dataPos);
-    m.haveVesselAccel = true;
-}
+    misses++;
 
-void gpsBinaryReader::processVesselAccelStdDev()
-{
-    m.vesselAccelXV1StdDev = makeFloat(rawData, dataPos);
-    m.vesselAccelXV2StdDev = makeFloat(rawData, dataPos);
-    m.vesselAccelXV3StdDev = makeFloat(rawData, dataPos);
-    m.haveVesselAccelStdDev = true;
-}
+    decodePlan p;
+    p.navDataBlockBitmask = navDataBlockBitmask;
+    p.extendedNavDataBlockBitmask = extendedNavDataBlockBitmask;
+    p.externDataBitMask = externDataBitMask;
+    p.headerSize = headerSize;
 
-void gpsBinaryReader::processVesselRotationRateStdDev()
-{
-    m.vesselRotationRateXV1StdDev = makeFloat(rawData, dataPos);
-    m.vesselRotationRateXV2StdDev = makeFloat(rawData, dataPos);
-    m.vesselRotationRateXV3StdDev = makeFloat(rawData, dataPos);
-    m.haveVesselRotationRateStdDev = true;
-}
+    uint16_t pos = headerSize;
+    pos = addBlocksToPlan(p, navDataBlocks, navDataBlockBitmask, pos);
+    pos = addBlocksToPlan(p, extendedNavDataBlocks, extendedNavDataBlockBitmask, pos);
+    p.navigationDataSize = pos - headerSize;
+    // exteRNAL sensor data blocks. Only those we know the layout of
+    // are decoded, these are always first in the telegram.
+    p.dataEnd = addBlocksToPlan(p, externDataBlocks, externDataBitMask & externDataKnownMask, pos);
 
-void gpsBinaryReader::processExtendedRotationAccelData()
-{
-    m.rawRotationAccelXV1 = makeFloat(rawData, dataPos);
-    m.rawRotationAccelXV2 = makeFloat(rawData, dataPos);
-    m.rawRotationAccelXV3 = makeFloat(rawData, dataPos);
-    m.haveExtendedRawRotationAccelData = true;
-}
-
-void gpsBinaryReader::processExtendedRotationAccelStdDevData()
-{
-    m.rawRotationAccelStdDevXV1 = makeFloat(rawData, dataPos);
-    m.rawRotationAccelStdDevXV2 = makeFloat(rawData, dataPos);
-    m.rawRotationAccelStdDevXV3 = makeFloat(rawData, dataPos);
-    m.haveExtendedRawRotationAccelStdDevData = true;
+    if(plans.size() < maxPlans)
+    {
+        plans.push_back(p);
+        lastPlanIndex = plans.size() - 1;
+    } else {
+        // Should not happen with a real unit; recycle the oldest plan.
+        lastPlanIndex = nextPlanToReplace;
+        nextPlanToReplace = (nextPlanToReplace + 1) % maxPlans;
+        plans[lastPlanIndex] = p;
+    }
+    return &plans[lastPlanIndex];
 }
 
-void gpsBinaryReader::processExtendedRawRotationRateData()
+uint64_t decodePlanCache::getHits()
 {
-    m.rawRotationRateXV1 = makeFloat(rawData, dataPos);
-    m.rawRotationRateXV2 = makeFloat(rawData, dataPos);
-    m.rawRotationRateXV3 = makeFloat(rawData, dataPos);
-    m.haveExtendedRawRotationRateData = true;
+    return hits;
 }
 
-void gpsBinaryReader::processUTC()
+uint64_t decodePlanCache::getMisses()
 {
-    m.UTCdataValidityTime = makeDWord(rawData, dataPos);
-    m.UTCSource = (unsigned char)rawData.at(dataPos); dataPos++;
-    m.haveUTC = true;
+    return misses;
 }
 
-void gpsBinaryReader::processGNSS(int num)
+void telegramDecoder::runDecodePlan(const decodePlan *plan)
 {
-    gnssInfo *g = &m.gnss[num-1];
-
-    g->gnssDataValidityTime = makeLong(rawData, dataPos);
-    g->gnssIdentification = (unsigned char)rawData.at(dataPos); dataPos++;
-    g->gnssQuality = (unsigned char)rawData.at(dataPos); dataPos++;
-    g->gnssGPSQuality = static_cast<gpsQualityKinds>(g->gnssQuality);
-    g->gnssLatitude = makeDouble(rawData, dataPos);
-    g->gnssLongitude = makeDouble(rawData, dataPos);
-    g->gnssAltitude = makeFloat(rawData, dataPos);
-    g->gnssLatStdDev = makeFloat(rawData, dataPos);
-    g->gnssLongStddev = makeFloat(rawData, dataPos);
-    g->gnssAltStdDev = makeFloat(rawData, dataPos);
-    g->LatLongCovariance = makeFloat(rawData, dataPos);
-    g->geoidalSep = makeFloat(rawData, dataPos);
-
-    g->populated = true;
+    char *dest = (char*)&m;
+    const decodePlanOp *ops = plan->ops.data();
+    size_t count = plan->ops.size();
+    for(size_t i=0; i < count; i++)
+    {
+        const decodePlanOp &op = ops[i];
+        switch(op.kind)
+        {
+        case fieldByte: {
+            unsigned char v = makeByte(rawBytes, op.srcOffset);
+            memcpy(dest + op.dstOffset, &v, sizeof(v));
+            break; }
+        case fieldWord: {
+            word v = makeWord(rawBytes, op.srcOffset);
+            memcpy(dest + op.dstOffset, &v, sizeof(v));
+            break; }
+        case fieldDWord: {
+            dword v = makeDWord(rawBytes, op.srcOffset);
+            memcpy(dest + op.dstOffset, &v, sizeof(v));
+            break; }
+        case fieldLong: {
+            long v = makeLong(rawBytes, op.srcOffset);
+            memcpy(dest + op.dstOffset, &v, sizeof(v));
+            break; }
+        case fieldFloat: {
+            float v = makeFloat(rawBytes, op.srcOffset);
+            memcpy(dest + op.dstOffset, &v, sizeof(v));
+            break; }
+        case fieldDouble: {
+            double v = makeDouble(rawBytes, op.srcOffset);
+            memcpy(dest + op.dstOffset, &v, sizeof(v));
+            break; }
+        case fieldQuality: {
+            gpsQualityKinds v = static_cast<gpsQualityKinds>(makeByte(rawBytes, op.srcOffset));
+            memcpy(dest + op.dstOffset, &v, sizeof(v));
+            break; }
+        case fieldFlag: {
+            bool v = true;
+            memcpy(dest + op.dstOffset, &v, sizeof(v));
+            break; }
+        case fieldRun32:
+            if(haveBytes(op.srcOffset, 4*op.count))
+                swapBigEndian32(dest + op.dstOffset, rawBytes + op.srcOffset, op.count);
+            break;
+        default:
+            break;
+        }
+    }
 }
 
-
 // Helper functions:
 
 unsigned char gpsBinaryReader::getBit(uint32_t d, unsigned char bit)
@@ -744,90 +705,101 @@ unsigned char gpsBinaryReader::getBit(uint32_t d, unsigned char bit)
     //qDebug() << "d: " << d << " bit: " << bit << ", result: " << ((d & ( 1 << bit )) >> bit);
     return((d & ( 1 << bit )) >> bit);
 }
+
+bool telegramDecoder::haveBytes(size_t startPos, size_t n)
+{
+    // Guards reads from the caller's buffer, which, unlike
+    // QByteArray::at(), are never checked anywhere else.
+    if((n > rawLength) || (startPos > rawLength - n))
+    {
+        readOverrun = true;
+        return false;
+    }
+    return true;
+}
+
 // startPos is the MSB
-dword gpsBinaryReader::makeDWord(QByteArray d, uint16_t startPos)
+dword telegramDecoder::makeDWord(const uint8_t *d, size_t startPos)
 {
     // Unsigned 32-Bit Int
     dataPos +=4;
-    return (unsigned char)d.at(startPos+3) | ((unsigned char)d.at(startPos+2) << 8) | ((unsigned char)d.at(startPos+1) << 16) | ((unsigned char)d.at(startPos+0) << 24);
+    if(!haveBytes(startPos, 4))
+        return 0;
+    return d[startPos+3] | (d[startPos+2] << 8) | (d[startPos+1] << 16) | ((dword)d[startPos+0] << 24);
 }
 
-word gpsBinaryReader::makeWord(QByteArray d, uint16_t startPos)
+word telegramDecoder::makeWord(const uint8_t *d, size_t startPos)
 {
     // Unsigned 16-Bit Int
     dataPos +=2;
-    return (unsigned char)d.at(startPos+1) | ((unsigned char)d.at(startPos+0) << 8);
+    if(!haveBytes(startPos, 2))
+        return 0;
+    return d[startPos+1] | (d[startPos+0] << 8);
 }
 
-short gpsBinaryReader::makeShort(QByteArray d, uint16_t startPos)
+short telegramDecoder::makeShort(const uint8_t *d, size_t startPos)
 {
     // Signed 16-Bit Int
     dataPos +=2;
-    return (unsigned char)d.at(startPos+1) | ((unsigned char)d.at(startPos+0) << 8);
+    if(!haveBytes(startPos, 2))
+        return 0;
+    return d[startPos+1] | (d[startPos+0] << 8);
 }
 
-long gpsBinaryReader::makeLong(QByteArray d, uint16_t startPos)
+long telegramDecoder::makeLong(const uint8_t *d, size_t startPos)
 {
     // Signed 32-Bit Int
     dataPos +=4;
-    return (unsigned char)d.at(startPos+3) | ((unsigned char)d.at(startPos+2) << 8) | ((unsigned char)d.at(startPos+1) << 16) | ((unsigned char)d.at(startPos+3) << 24);
+    if(!haveBytes(startPos, 4))
+        return 0;
+    return (long)(int32_t)(((uint32_t)d[startPos+0] << 24) | (d[startPos+1] << 16) | (d[startPos+2] << 8) | d[startPos+3]);
 }
 
-float gpsBinaryReader::makeFloat(QByteArray d, uint16_t startPos)
+unsigned char telegramDecoder::makeByte(const uint8_t *d, size_t startPos)
+{
+    // Unsigned 8-Bit Int
+    dataPos +=1;
+    if(!haveBytes(startPos, 1))
+        return 0;
+    return d[startPos];
+}
+
+float telegramDecoder::makeFloat(const uint8_t *d, size_t startPos)
 {
     // IEEE 32-Bit Float
     dataPos +=4;
     float f=0.0;
-    unsigned char bytes[] = { (unsigned char)d.at(startPos+3),   (unsigned char)d.at(startPos+2),
-                              (unsigned char)d.at(startPos+1), (unsigned char)d.at(startPos) };
-
-    memcpy(&f, bytes, sizeof(f));
+    if(!haveBytes(startPos, 4))
+        return f;
+    uint32_t bits = d[startPos+3] | (d[startPos+2] << 8) | (d[startPos+1] << 16) | ((uint32_t)d[startPos+0] << 24);
+    memcpy(&f, &bits, sizeof(f));
     return f;
 }
 
-double gpsBinaryReader::makeDouble(QByteArray a, uint16_t startPos)
+double telegramDecoder::makeDouble(const uint8_t *a, size_t startPos)
 {
     // IEEE 64-Bit Float
     //qDebug() << "Reading 64-bit 'double' from position: " << dataPos;
     dataPos +=8;
     double d=0.0;
-
-    unsigned char bytes[] = {  (unsigned char)a.at(startPos+7), (unsigned char)a.at(startPos+6),
-                               (unsigned char)a.at(startPos+5), (unsigned char)a.at(startPos+4),
-                               (unsigned char)a.at(startPos+3), (unsigned char)a.at(startPos+2),
-                               (unsigned char)a.at(startPos+1), (unsigned char)a.at(startPos) };
-
-    memcpy(&d, bytes, sizeof(d));
-    return d;
-}
-
-void gpsBinaryReader::copyQStringToCharArray(char *array, QString s)
-{
-    // This is a helper function for people that like to live dangerously.
-    if(s.length() > 64-2)
-        s.truncate(64-2);
-    for(int i=0; i < s.length(); i++)
+    if(!haveBytes(startPos, 8))
+        return d;
+    uint64_t bits = 0;
+    for(int i=0; i < 8; i++)
     {
-        array[i] = s[i].toLatin1();
+        bits = (bits << 8) | a[startPos+i];
     }
-    array[s.length()] = '\0';
+    memcpy(&d, &bits, sizeof(d));
+    return d;
 }
 
-void gpsBinaryReader::getMessageSum()
+uint32_t telegramDecoder::getMessageSum()
 {
-    //messageSum = std::accumulate(rawData.begin(), rawData.end()-4, 0);
-
-    uint32_t sum = 0;
-    for(int i=0; i < rawData.length()-4; i++)
-    {
-        sum += (unsigned char)rawData.at(i);
-    }
-
-    messageSum = sum;
-    m.calculatedChecksum = sum;
     // Nominal size: usually 392, once per second 397 and 438 bytes. The -4 is because the checksum
     // does not include the size of the sum.
-    //qDebug() << "Byte Array length: " << rawData.length() << ", length-4: " << rawData.length()-4;
+    if(rawLength > 4)
+        return sumBytes(rawBytes, rawLength - 4);
+    return 0;
 }
 
 // Public Access Functions:
@@ -862,12 +834,24 @@ float gpsBinaryReader::getPitch()
     return m.pitch;
 }
 
+uint64_t gpsBinaryReader::getPlanCacheHits()
+{
+    return planCache.getHits();
+}
+
+uint64_t gpsBinaryReader::getPlanCacheMisses()
+{
+    return planCache.getMisses();
+}
+
 // Public Access Utility Functions:
 
 QString gpsBinaryReader::debugString()
 {
     // Use this to quickly return hex printouts as strings for debugging:
     QString s;
+    if(rawData.length() < 30)
+        return s;
     s = QString("0x%1 0x%2 0x%3 0x%4").arg(rawData.at(27), 4, 16, QChar('0')).arg(rawData.at(28), 4, 16, QChar('0')).arg(rawData.at(29), 4, 16, QChar('0'));
     return s;
 }
@@ -906,7 +890,7 @@ void gpsBinaryReader::printMessage(gpsMessage g)
 
 void gpsBinaryReader::printAlgorithmStatusMessages(gpsMessage g)
 {
-    if(g.haveINSAlgorithmStatus)
+    if(g.haveINSAlgorithmStatus())
     {
         qDebug() << m.counter << ": " << getBit(g.algorithmStatus1, 0)
                  << getBit(g.algorithmStatus1, 1)
@@ -935,7 +919,7 @@ void gpsBinaryReader::printMessage()
 {
     qDebug() << "---------- BEGIN printing GPS message for counter " << m.counter << ": ----------";
     qDebug() << "validDecode: " << m.validDecode;
-    qDebug() << "Last decoder error message: " << m.lastDecodeErrorMessage;
+    qDebug() << "Last decoder error message: " << decodeErrorString(m);
     qDebug() << "Number of recently dropped mesages: " << m.numberDropped;
     qDebug() << "---Header:---";
     qDebug() << "messageType: " << m.mType;
@@ -954,41 +938,41 @@ void gpsBinaryReader::printMessage()
     qDebug() << "--- end header.";
     qDebug();
     qDebug() << "--- Avaialble data: ---";
-    qDebug() << "haveAltitudeHeading: " << m.haveAltitudeHeading;
-    qDebug() << "haveAltitudeHeadingStdDev: " << m.haveAltitudeHeadingStdDev;
-    qDebug() << "haveRealTimeHeaveSurgeSwayData: " << m.haveRealTimeHeaveSurgeSwayData;
-    qDebug() << "haveSmartHeaveData: " << m.haveSmartHeaveData;
-    qDebug() << "haveHeadingRollPitchRate: " << m.haveHeadingRollPitchRate;
-    qDebug() << "haveBodyRotationRate: " << m.haveBodyRotationRate;
-    qDebug() << "haveAccel vessel frame: " << m.haveAccel;
-    qDebug() << "havePosition: " << m.havePosition;
-    qDebug() << "havePositionStdDev: " << m.havePositionStdDev;
-    qDebug() << "haveSpeedData: " << m.haveSpeedData;
-    qDebug() << "haveSpeedStdDev: " << m.haveSpeedStdDev;
-    qDebug() << "haveCurrentData: " << m.haveCurrentData;
-    qDebug() << "haveCurrentStdDev: " << m.haveCurrentStdDev;
-    qDebug() << "haveSystemDateData: " << m.haveSystemDateData;
-    qDebug() << "haveINSSensorStatus: " << m.haveINSSensorStatus;
-    qDebug() << "haveINSAlgorithmStatus: " << m.haveINSAlgorithmStatus;
-    qDebug() << "haveINSSystemStatus: " << m.haveINSSystemStatus;
-    qDebug() << "haveINSUserStatus: " << m.haveINSUserStatus;
-    qDebug() << "processHeaveSurgeSwaySpeed: " << m.haveHeaveSurgeSwaySpeedData;
-    qDebug() << "haveSpeedVesselData: " << m.haveSpeedVesselData;
-    qDebug() << "haveAccelGeographicData: " << m.haveAccelGeographicData;
-    qDebug() << "haveCourseSpeedGroundData: " << m.haveCourseSpeedGroundData;
-    qDebug() << "haveTempData: " << m.haveTempData;
-    qDebug() << "haveAttitudeQuaternionData: " << m.haveAttitudeQuaternionData;
-    qDebug() << "haveAttitudeQEData: " << m.haveAttitudeQEData;
-    qDebug() << "haveVesselAccel: " << m.haveVesselAccel;
-    qDebug() << "haveVesselAccelStdDev: " << m.haveVesselAccelStdDev;
-    qDebug() << "haveVesselRotationRateStdDev: " << m.haveVesselRotationRateStdDev;
-    qDebug() << "haveUTC: " << m.haveUTC;
-    qDebug() << "have GNSS 1: " << m.haveGNSSInfo1;
-    qDebug() << "have GNSS 2: " << m.haveGNSSInfo2;
-    qDebug() << "have GNSS 3: " << m.haveGNSSInfo3;
+    qDebug() << "haveAltitudeHeading: " << m.haveAltitudeHeading();
+    qDebug() << "haveAltitudeHeadingStdDev: " << m.haveAltitudeHeadingStdDev();
+    qDebug() << "haveRealTimeHeaveSurgeSwayData: " << m.haveRealTimeHeaveSurgeSwayData();
+    qDebug() << "haveSmartHeaveData: " << m.haveSmartHeaveData();
+    qDebug() << "haveHeadingRollPitchRate: " << m.haveHeadingRollPitchRate();
+    qDebug() << "haveBodyRotationRate: " << m.haveBodyRotationRate();
+    qDebug() << "haveAccel vessel frame: " << m.haveAccel();
+    qDebug() << "havePosition: " << m.havePosition();
+    qDebug() << "havePositionStdDev: " << m.havePositionStdDev();
+    qDebug() << "haveSpeedData: " << m.haveSpeedData();
+    qDebug() << "haveSpeedStdDev: " << m.haveSpeedStdDev();
+    qDebug() << "haveCurrentData: " << m.haveCurrentData();
+    qDebug() << "haveCurrentStdDev: " << m.haveCurrentStdDev();
+    qDebug() << "haveSystemDateData: " << m.haveSystemDateData();
+    qDebug() << "haveINSSensorStatus: " << m.haveINSSensorStatus();
+    qDebug() << "haveINSAlgorithmStatus: " << m.haveINSAlgorithmStatus();
+    qDebug() << "haveINSSystemStatus: " << m.haveINSSystemStatus();
+    qDebug() << "haveINSUserStatus: " << m.haveINSUserStatus();
+    qDebug() << "processHeaveSurgeSwaySpeed: " << m.haveHeaveSurgeSwaySpeedData();
+    qDebug() << "haveSpeedVesselData: " << m.haveSpeedVesselData();
+    qDebug() << "haveAccelGeographicData: " << m.haveAccelGeographicData();
+    qDebug() << "haveCourseSpeedGroundData: " << m.haveCourseSpeedGroundData();
+    qDebug() << "haveTempData: " << m.haveTempData();
+    qDebug() << "haveAttitudeQuaternionData: " << m.haveAttitudeQuaternionData();
+    qDebug() << "haveAttitudeQEData: " << m.haveAttitudeQEData();
+    qDebug() << "haveVesselAccel: " << m.haveVesselAccel();
+    qDebug() << "haveVesselAccelStdDev: " << m.haveVesselAccelStdDev();
+    qDebug() << "haveVesselRotationRateStdDev: " << m.haveVesselRotationRateStdDev();
+    qDebug() << "haveUTC: " << m.haveUTC();
+    qDebug() << "have GNSS 1: " << m.haveGNSSInfo1();
+    qDebug() << "have GNSS 2: " << m.haveGNSSInfo2();
+    qDebug() << "have GNSS 3: " << m.haveGNSSInfo3();
     qDebug() << "--- end list of available data.";
 
-    if(m.haveAltitudeHeading)
+    if(m.haveAltitudeHeading())
     {
         qDebug() << "--- Altitude Heading: ---";
         qDebug() << "heading: " << m.heading;
@@ -996,14 +980,14 @@ void gpsBinaryReader::printMessage()
         qDebug() << "pitch: " << m.pitch;
     }
 
-    if(m.haveAltitudeHeadingStdDev)
+    if(m.haveAltitudeHeadingStdDev())
     {
         qDebug() << "--- Altitude Heading StdDev: ---";
         qDebug() << "heading std dev: " << m.headingStardardDeviation;
         qDebug() << "roll std dev: " << m.rollStandardDeviation;
         qDebug() << "pitch std dev: " << m.pitchStandardDeviation;
     }
-    if(m.haveRealTimeHeaveSurgeSwayData)
+    if(m.haveRealTimeHeaveSurgeSwayData())
     {
         qDebug() << "--- Navigation Bit 2 Real-time Surge Sway Data: ---";
         qDebug() << "rt_heave_withoutBdL: " << m.rt_heave_withoutBdL;
@@ -1011,34 +995,34 @@ void gpsBinaryReader::printMessage()
         qDebug() << "rt_surge_atBdL: " << m.rt_surge_atBdL;
         qDebug() << "rt_sway_atBdL: " << m.rt_sway_atBdL;
     }
-    if(m.haveSmartHeaveData)
+    if(m.haveSmartHeaveData())
     {
         qDebug() << "--- Navigation Bit 3 Smart Heave Data: ---";
         qDebug() << "smartHeaveValidityTime_100us: " << m.smartHeaveValidityTime_100us;
         qDebug() << "smartHeave_m: " << m.smartHeave_m;
     }
-    if(m.haveHeadingRollPitchRate)
+    if(m.haveHeadingRollPitchRate())
     {
         qDebug() << "--- Heading Roll Pitch Rate: ---";
         qDebug() << "heading rotation rate: " << m.headingRotationRate;
         qDebug() << "roll rotation rate: " << m.rollRotationRate;
         qDebug() << "pitch rotation rate: " << m.pitchRotationRate;
     }
-    if(m.haveBodyRotationRate)
+    if(m.haveBodyRotationRate())
     {
         qDebug() << "--- Body rotation rate: ---";
         qDebug() << "rotationRateXV1: " << m.rotationRateXV1;
         qDebug() << "rotationRateXV2: " << m.rotationRateXV2;
         qDebug() << "rotationRateXV3: " << m.rotationRateXV3;
     }
-    if(m.haveAccel)
+    if(m.haveAccel())
     {
         qDebug() << "--- Vessel Accel (bit 6): ---";
         qDebug() << "accelXV1: " << m.accelXV1;
         qDebug() << "accelXV2: " << m.accelXV2;
         qDebug() << "accelXV3: " << m.accelXV3;
     }
-    if(m.havePosition)
+    if(m.havePosition())
     {
         qDebug() << "--- Position Data (bit 7): ---";
         qDebug() << "latitude: " << m.latitude;
@@ -1047,7 +1031,7 @@ void gpsBinaryReader::printMessage()
         qDebug() << "altitude: " << m.altitude;
     }
 
-    if(m.havePositionStdDev)
+    if(m.havePositionStdDev())
     {
         qDebug() << "--- havePositionStdDev Data (bit 8): ---";
         qDebug() << "northStdDev: " << m.northStdDev;
@@ -1056,7 +1040,7 @@ void gpsBinaryReader::printMessage()
         qDebug() << "altitudStdDev: " << m.altitudStdDev;
     }
 
-    if(m.haveSpeedData)
+    if(m.haveSpeedData())
     {
         qDebug() << "--- have Speed Data (bit 9): ---";
         qDebug() << "northVelocity: " << m.northVelocity;
@@ -1064,21 +1048,21 @@ void gpsBinaryReader::printMessage()
         qDebug() << "northVelocity: " << m.northVelocity;
     }
 
-    if(m.haveSpeedStdDev)
+    if(m.haveSpeedStdDev())
     {
         qDebug() << "--- have speed std dev data (bit 10): ---";
         qDebug() << "northVelocityStdDev: " << m.northVelocityStdDev;
         qDebug() << "eastVelocityStdDev: " << m.eastVelocityStdDev;
         qDebug() << "upVelocityStdDev: " << m.upVelocityStdDev;
     }
-    if(m.haveCurrentData)
+    if(m.haveCurrentData())
     {
         qDebug() << "--- have ocean current data (bit 12): ---";
         qDebug() << "northCurrentStdDev: " << m.northCurrentStdDev;
         qDebug() << "eastCurrentStdDev: " << m.eastCurrentStdDev;
     }
 
-    if(m.haveSystemDateData)
+    if(m.haveSystemDateData())
     {
         qDebug() << "--- System time and date: (bit 13): ---";
         qDebug() << "systemDay: " << (unsigned int)m.systemDay;
@@ -1087,7 +1071,7 @@ void gpsBinaryReader::printMessage()
     }
 
 
-    if(m.haveINSSensorStatus)
+    if(m.haveINSSensorStatus())
     {
         qDebug() << "--- have INS SENSOR Status (bit 14): ---";
         qDebug() << "insSensorStatus1: " << m.insSensorStatus1;
@@ -1096,7 +1080,7 @@ void gpsBinaryReader::printMessage()
         printBinary(m.insSensorStatus2);
     }
 
-    if(m.haveINSAlgorithmStatus)
+    if(m.haveINSAlgorithmStatus())
     {
         qDebug() << "--- have INS Algorithm Status (bit 15): ---";
         qDebug() << "algorithmStatus1: " << m.algorithmStatus1;
@@ -1109,7 +1093,7 @@ void gpsBinaryReader::printMessage()
         printBinary(m.algorithmStatus4);
         printAlgorithmStatusMessages(m);
     }
-    if(m.haveINSSystemStatus)
+    if(m.haveINSSystemStatus())
     {
         qDebug() << "--- have INS SYSTEM Status (bit 16): ---";
         qDebug() << "systemStatus1: " << m.systemStatus1;
@@ -1119,7 +1103,7 @@ void gpsBinaryReader::printMessage()
         qDebug() << "systemStatus3: " << m.systemStatus3;
         printBinary(m.systemStatus3);
     }
-    if(m.haveINSUserStatus)
+    if(m.haveINSUserStatus())
     {
         qDebug() << "--- have INS USER Status (bit 17): ---";
         qDebug() << "INSuserStatus: " << m.INSuserStatus;
@@ -1128,7 +1112,7 @@ void gpsBinaryReader::printMessage()
 
     // Note: Navigation bitmask bits 18, 19,and 20 have always been zero.
 
-    if(m.haveHeaveSurgeSwaySpeedData)
+    if(m.haveHeaveSurgeSwaySpeedData())
     {
         qDebug() << "--- Heave Surge Sway Speed Data (bit 21): --";
         qDebug() << "realtime_heave_speed: " << m.realtime_heave_speed;
@@ -1136,27 +1120,27 @@ void gpsBinaryReader::printMessage()
         qDebug() << "sway_speed: " << m.sway_speed;
     }
 
-    if(m.haveSpeedVesselData)
+    if(m.haveSpeedVesselData())
     {
         qDebug() << "--- Vessel speed block Data (bit 22): ---";
         qDebug() << "vesselXV1Velocity: " << m.vesselXV1Velocity;
         qDebug() << "vesselXV2Velocity: " << m.vesselXV2Velocity;
         qDebug() << "vesselXV3Velocity: " << m.vesselXV3Velocity;
     }
-    if(m.haveAccelGeographicData)
+    if(m.haveAccelGeographicData())
     {
         qDebug() << "--- Accel Geographic Data Data (bit 23): ---";
         qDebug() << "geographicNorthAccel: " << m.geographicNorthAccel;
         qDebug() << "geographicEastAccel: " << m.geographicEastAccel;
         qDebug() << "geographicVertAccel: " << m.geographicVertAccel;
     }
-    if(m.haveCourseSpeedGroundData)
+    if(m.haveCourseSpeedGroundData())
     {
         qDebug() << "--- Course and Speed over ground (bit 24): ---";
         qDebug() << "courseOverGround (degrees): " << m.courseOverGround;
         qDebug() << "speedOverGround: " << m.speedOverGround;
     }
-    if(m.haveTempData)
+    if(m.haveTempData())
     {
         qDebug() << "--- Temperature data (bit 25): ---";
         qDebug() << "meanTempFOG: " << m.meanTempFOG;
@@ -1164,7 +1148,7 @@ void gpsBinaryReader::printMessage()
         qDebug() << "meanTempSensor: "<< m.meanTempSensor;
     }
 
-    if(m.haveAttitudeQuaternionData)
+    if(m.haveAttitudeQuaternionData())
     {
         qDebug() << "--- Attitude Quaternion Data (bit 26): ---";
         qDebug() << "attitudeQCq0: " << m.attitudeQCq0;
@@ -1172,28 +1156,28 @@ void gpsBinaryReader::printMessage()
         qDebug() << "attitudeQCq2: " << m.attitudeQCq2;
         qDebug() << "attitudeQCq3: " << m.attitudeQCq3;
     }
-    if(m.haveAttitudeQEData)
+    if(m.haveAttitudeQEData())
     {
         qDebug() << "--- Attitude Quaternion E-Data (bit 27): ---";
         qDebug() << "attitudeQE1: " << m.attitudeQE1;
         qDebug() << "attitudeQE2: " << m.attitudeQE2;
         qDebug() << "attitudeQE3: " << m.attitudeQE3;
     }
-    if(m.haveVesselAccel)
+    if(m.haveVesselAccel())
     {
         qDebug() << "--- Raw Vessel Acceleration Data (bit 28): ---";
         qDebug() << "vesselAccelXV1: " << m.vesselAccelXV1;
         qDebug() << "vesselAccelXV1: " << m.vesselAccelXV1;
         qDebug() << "vesselAccelXV1: " << m.vesselAccelXV1;
     }
-    if(m.haveVesselAccelStdDev)
+    if(m.haveVesselAccelStdDev())
     {
         qDebug() << "--- Vessel Acceleration Std Dev (bit 29): ---";
         qDebug() << "vesselAccelXV1StdDev: " << m.vesselAccelXV1StdDev;
         qDebug() << "vesselAccelXV2StdDev: " << m.vesselAccelXV2StdDev;
         qDebug() << "vesselAccelXV3StdDev: " << m.vesselAccelXV3StdDev;
     }
-    if(m.haveVesselRotationRateStdDev)
+    if(m.haveVesselRotationRateStdDev())
     {
         qDebug() << "--- Vessel Rotation Rate Std Dev (bit 30): ---";
         qDebug() << "vesselRotationRateXV1StdDev: " << m.vesselRotationRateXV1StdDev;
@@ -1204,21 +1188,21 @@ void gpsBinaryReader::printMessage()
     qDebug() << "----- END Navigation Data Blocks -----";
 
     qDebug() << "----- BEGIN Extended Navigation Data Blocks -----";
-    if(m.haveExtendedRawRotationAccelData)
+    if(m.haveExtendedRawRotationAccelData())
     {
         qDebug() << "--- Extended Raw Rotation AccelData (bit 0): ---";
         qDebug() << "rawRotationAccelXV1: " << m.rawRotationAccelXV1;
         qDebug() << "rawRotationAccelXV2: " << m.rawRotationAccelXV2;
         qDebug() << "rawRotationAccelXV3: " << m.rawRotationAccelXV3;
     }
-    if(m.haveExtendedRawRotationAccelStdDevData)
+    if(m.haveExtendedRawRotationAccelStdDevData())
     {
         qDebug() << "--- Extended Raw Rotation Accel Std Dev Data (bit 1): ---";
         qDebug() << "rawRotationAccelStdDevXV1: " << m.rawRotationAccelStdDevXV1;
         qDebug() << "rawRotationAccelStdDevXV2: " << m.rawRotationAccelStdDevXV2;
         qDebug() << "rawRotationAccelStdDevXV3: " << m.rawRotationAccelStdDevXV3;
     }
-    if(m.haveExtendedRawRotationRateData)
+    if(m.haveExtendedRawRotationRateData())
     {
         qDebug() << "--- Extended Raw Rotation Rate Data (bit 2): ---";
         qDebug() << "rawRotationRateXV1: " << m.rawRotationRateXV1;
@@ -1231,24 +1215,24 @@ void gpsBinaryReader::printMessage()
     //if(m.externDataBitMask != 0)
 
         qDebug() << "----- BEGIN External Data Blocks: ";
-        if(m.haveUTC)
+        if(m.haveUTC())
         {
             qDebug() << "--- UTC: ---";
             qDebug() << "UTC Data Validity time: " << m.UTCdataValidityTime;
             qDebug() << "UTC Source: " << m.UTCSource;
         }
 
-        if(m.haveGNSSInfo1)
+        if(m.haveGNSSInfo1())
         {
             qDebug() << "--- GNSS 1: ---";
             printGNSSInfo(1);
         }
-        if(m.haveGNSSInfo2)
+        if(m.haveGNSSInfo2())
         {
             qDebug() << "--- GNSS 2: ---";
             printGNSSInfo(2);
         }
-        if(m.haveGNSSInfo3)
+        if(m.haveGNSSInfo3())
         {
             qDebug() << "--- GNSS 3: ---";
             printGNSSInfo(3);
@@ -1258,11 +1242,11 @@ void gpsBinaryReader::printMessage()
 
     // Repeat for good measure:
     qDebug() << "Valid Decode: " << m.validDecode;
-    qDebug() << "Last error: " << m.lastDecodeErrorMessage;
+    qDebug() << "Last error: " << decodeErrorString(m);
 
-    qDebug() << "Calculated Message Sum: " << messageSum;
+    qDebug() << "Calculated Message Sum: " << m.calculatedChecksum;
     qDebug() << "Claimed Message Sum:    " << m.claimedMessageSum;
-    qDebug() << "Checksum good?:         " << (messageSum==m.claimedMessageSum);
+    qDebug() << "Checksum good?:         " << (m.calculatedChecksum==m.claimedMessageSum);
     qDebug() << "---------- END message decode for counter " << m.counter << " ----------";
 
 }
@@ -1,7 +1,8 @@
 #ifndef GPSBINARYREADER_H
 #define GPSBINARYREADER_H
 
-#include <mutex>
+#include <stddef.h>
+#include <vector>
 
 #include <QByteArray>
 #include <QDebug>
@@ -24,19 +25,32 @@ enum gpsQualityKinds {
 };
 
 struct gnssInfo {
-    bool populated = false;
-    long gnssDataValidityTime;
-    unsigned char gnssIdentification; // 0 = GNSS1, 2 = Manual GNSS
-    unsigned char gnssQuality;
-    gpsQualityKinds gnssGPSQuality;
     double gnssLatitude; // -90 to 90
     double gnssLongitude; // 0-360
+    long gnssDataValidityTime;
     float gnssAltitude;
     float gnssLatStdDev;
     float gnssLongStddev;
     float gnssAltStdDev;
     float LatLongCovariance;
     float geoidalSep;
+    gpsQualityKinds gnssGPSQuality;
+    unsigned char gnssIdentification; // 0 = GNSS1, 2 = Manual GNSS
+    unsigned char gnssQuality;
+    bool populated = false;
+};
+
+// Result of decoding one telegram:
+enum gpsDecodeStatus {
+    decodeOK = 0,
+    decodeShortMessage,           // too short to hold a header
+    decodeUnsupportedType,        // not an IX navigation telegram
+    decodeUnknownProtocol,        // protocol version other than 2, 3 or 5
+    decodeUnknownNavData,         // navigation data blocks of unknown layout
+    decodeUnknownExtendedNavData, // extended navigation data blocks of unknown layout
+    decodeBadNavDataSize,         // navigationDataSize does not match the bitmasks
+    decodeTruncated,              // data blocks run past the end of the telegram
+    decodeBadChecksum
 };
 
 // To match the exact wording of the ICD:
@@ -45,22 +59,39 @@ struct gnssInfo {
 
 struct gpsMessage {
 
-    bool validDecode = false;
-    uint32_t numberDropped = 0;
-    char lastDecodeErrorMessage[64];
+    // The first 64 bytes hold what nearly every consumer reads:
+    // the presence bitmasks, the counter, position and attitude.
 
-    // Header:
-    messageKinds mType;
-    char protoVers;
+    // Header, presence of each data block by bit number:
     dword navDataBlockBitmask = 0;
     dword extendedNavDataBlockBitmask = 0;
     dword externDataBitMask = 0;
+    dword counter = 0;
+
+    // Position data (bit 7):
+    double latitude;
+    double longitude;
+    float altitude;
+    unsigned char altitudeReference;
+
+    bool validDecode = false;
+    char protoVers;
+
+    // Altitude and Heading data Block (bit 0):
+    float heading;
+    float roll;
+    float pitch;
 
-    word navigationDataSize = 0;
-    word totalTelegramSize = 0;
     dword navDataValidityTime = 0;
-    dword counter = 0;
+    uint32_t numberDropped = 0;
+    gpsDecodeStatus decodeStatus = decodeOK; // see gpsBinaryReader::decodeErrorString()
 
+    // End of the first cache line.
+
+    dword decodeErrorDetail = 0; // the offending value, where there is one
+    messageKinds mType;
+    word navigationDataSize = 0;
+    word totalTelegramSize = 0;
     dword claimedMessageSum = 0;
     dword calculatedChecksum = 0;
 
@@ -69,18 +100,10 @@ struct gpsMessage {
     //  Begin Navigation Data
     //
 
-
-    // Altitude and Heading data Block (bit 0):
-    float heading;
-    float roll;
-    float pitch;
-    bool haveAltitudeHeading = false;
-
     // Altitude and Heading standard deviation data block (bit 1):
     float headingStardardDeviation;
     float rollStandardDeviation;
     float pitchStandardDeviation;
-    bool haveAltitudeHeadingStdDev = false;
 
     // Mystery data, bit 2: RealTimeHeaveSurgeSway
 
@@ -88,94 +111,72 @@ struct gpsMessage {
     float rt_heave_atBdL;      /*! Meters - positive UP in horizontal vehicle frame */
     float rt_surge_atBdL; /*! Meters - positive FORWARD in horizontal vehicle frame */
     float rt_sway_atBdL;  /*! Meters - positive PORT SIDE in horizontal vehicle frame */
-    bool haveRealTimeHeaveSurgeSwayData = false;
 
     // SmartHeave data, bit 3:
     dword smartHeaveValidityTime_100us;
     float smartHeave_m;
-    bool haveSmartHeaveData = false;
 
     // Heading/Roll/Pitch rate data block (bit 4):
     float headingRotationRate;
     float rollRotationRate;
     float pitchRotationRate;
-    bool haveHeadingRollPitchRate = false;
 
     // Body rotation rate data block in vessel frame (bit 5):
     float rotationRateXV1;
     float rotationRateXV2;
     float rotationRateXV3;
-    bool haveBodyRotationRate = false;
 
     // Accelerations data block in vessel frame (bit 6):
     float accelXV1;
     float accelXV2;
     float accelXV3;
-    bool haveAccel = false;
-
-    // Position data (bit 7):
-    double latitude;
-    double longitude;
-    unsigned char altitudeReference;
-    float altitude;
-    bool havePosition = false;
 
     // Position standard deviation data block (bit 8):
     float northStdDev;
     float eastStdDev;
     float neCorrelation;
     float altitudStdDev;
-    bool havePositionStdDev = false;
 
     // Speed data block in geographic frame (bit 9):
     float northVelocity;
     float eastVelocity;
     float upVelocity;
-    bool haveSpeedData = false;
 
     // Speed standard deviation data block in geographic frame (bit 10):
     float northVelocityStdDev;
     float eastVelocityStdDev;
     float upVelocityStdDev;
-    bool haveSpeedStdDev = false;
 
     // (ocean) Current data block in geographic frame (bit 11):
     float northCurrent;
     float eastCurrent;
-    bool haveCurrentData = false;
 
     // (ocean) Current standard deviation data block in gepgraphic frame (bit 12):
     float northCurrentStdDev;
     float eastCurrentStdDev;
-    bool haveCurrentStdDev = false;
 
     // System date data block (bit 13):
     unsigned char systemDay;
     unsigned char systemMonth;
     word systemYear;
-    bool haveSystemDateData = false;
 
     // INS Sensor Status (bit 14):
     dword insSensorStatus1;
     dword insSensorStatus2;
-    bool haveINSSensorStatus = false;
 
     // INS Algorithm Status (bit 15):
     dword algorithmStatus1;
     dword algorithmStatus2;
     dword algorithmStatus3;
     dword algorithmStatus4;
-    bool haveINSAlgorithmStatus = false;
 
     // INS System Status (bit 16):
     dword systemStatus1;
     dword systemStatus2;
     dword systemStatus3;
-    bool haveINSSystemStatus = false;
 
     // INS User Status (bit 17):
     dword INSuserStatus;
-    bool haveINSUserStatus = false;
 
     // Bits 18, 19, and 20 have never been received
 
@@ -183,7 +184,6 @@ struct gpsMessage {
     float realtime_heave_speed;
     float surge_speed;
     float sway_speed;
-    bool haveHeaveSurgeSwaySpeedData = false;
 
     //    From the OEM software, these are the next ones ("reserved" in the spec):
     //    boost::optional<AHRSAlgorithmStatus> ahrsAlgorithmStatus;
@@ -194,55 +194,46 @@ struct gpsMessage {
     float vesselXV1Velocity;
     float vesselXV2Velocity;
     float vesselXV3Velocity;
-    bool haveSpeedVesselData = false;
 
     // Acceleration data block in geographic frame (bit 23):
     float geographicNorthAccel;
     float geographicEastAccel;
     float geographicVertAccel;
-    bool haveAccelGeographicData = false;
 
     // Course and speed over ground (bit 24):
     float courseOverGround;
     float speedOverGround;
-    bool haveCourseSpeedGroundData = false;
 
     // Temperatures (bit 25):
     float meanTempFOG;
     float meanTempACC;
     float meanTempSensor;
-    bool haveTempData = false;
 
     // Attitude quaternion (bit 26):
     float attitudeQCq0;
     float attitudeQCq1;
     float attitudeQCq2;
     float attitudeQCq3;
-    bool haveAttitudeQuaternionData = false;
 
     // Attitude quaternion standard deviation (bit 27):
     float attitudeQE1;
     float attitudeQE2;
     float attitudeQE3;
-    bool haveAttitudeQEData = false;
 
     // Raw acceleration in vessel frame (bit 28):
     float vesselAccelXV1;
     float vesselAccelXV2;
     float vesselAccelXV3;
-    bool haveVesselAccel = false;
 
     // Acceleration standard deviation in vessel frame (bit 29):
     float vesselAccelXV1StdDev;
     float vesselAccelXV2StdDev;
     float vesselAccelXV3StdDev;
-    bool haveVesselAccelStdDev = false;
 
     // Rotation rate standard deviation in vessel frame (bit 30):
     float vesselRotationRateXV1StdDev;
     float vesselRotationRateXV2StdDev;
     float vesselRotationRateXV3StdDev;
-    bool haveVesselRotationRateStdDev = false;
 
     //
     //  End Navigation Data
@@ -258,19 +249,16 @@ struct gpsMessage {
     float rawRotationAccelXV1;
     float rawRotationAccelXV2;
     float rawRotationAccelXV3;
-    bool haveExtendedRawRotationAccelData = false;
 
     // Rotation acceleration standard deviation in vessel frame (bit 1):
     float rawRotationAccelStdDevXV1;
     float rawRotationAccelStdDevXV2;
     float rawRotationAccelStdDevXV3;
-    bool haveExtendedRawRotationAccelStdDevData = false;
 
     // Raw rotation rate in vessel frame (bit 2):
     float rawRotationRateXV1;
     float rawRotationRateXV2;
     float rawRotationRateXV3;
-    bool haveExtendedRawRotationRateData = false;
 
     //
     //  End Extended Navigation Data
@@ -285,15 +273,9 @@ struct gpsMessage {
     // UTC data block (bit 0):
     dword UTCdataValidityTime;
     unsigned char UTCSource;
-    bool haveUTC = false;
 
     // GNSS and Manual GNSS data blocks (bits 1, 2, and 3):
     // may contain data for external (extra) GNSS inputs 2 and 3
-
-    bool haveGNSSInfo1 = false;
-    bool haveGNSSInfo2 = false;
-    bool haveGNSSInfo3 = false;
-
     gnssInfo gnss[3];
 
     // DMI:
@@ -303,8 +285,8 @@ struct gpsMessage {
     // Event Marker A to C data blocks (bits 18, 19, 20):
     // Read as many as three times?
     long eventDataValidityTime;
-    unsigned char eventIdentification;
     long eventCount;
+    unsigned char eventIdentification;
 
     // VTG1 and VTG2 data blocks (bits 25, 26):
     long vtgDataValidityTime_25;
@@ -324,99 +306,179 @@ struct gpsMessage {
     dword logBookIdentifier;
     char logBookCustomText[32] = {'0'};
 
+    //////////////////////
+    //
+    //  Presence of each data block, from the bitmasks. The blocks
+    //  are only decoded when the header checks out, so check
+    //  validDecode (or the decode status) first.
+    //
+
+    bool haveNavData(unsigned int bit) const { return (navDataBlockBitmask >> bit) & 1; }
+    bool haveExtendedNavData(unsigned int bit) const { return (extendedNavDataBlockBitmask >> bit) & 1; }
+    bool haveExternData(unsigned int bit) const { return (externDataBitMask >> bit) & 1; }
+
+    bool haveAltitudeHeading() const { return haveNavData(0); }
+    bool haveAltitudeHeadingStdDev() const { return haveNavData(1); }
+    bool haveRealTimeHeaveSurgeSwayData() const { return haveNavData(2); }
+    bool haveSmartHeaveData() const { return haveNavData(3); }
+    bool haveHeadingRollPitchRate() const { return haveNavData(4); }
+    bool haveBodyRotationRate() const { return haveNavData(5); }
+    bool haveAccel() const { return haveNavData(6); }
+    bool havePosition() const { return haveNavData(7); }
+    bool havePositionStdDev() const { return haveNavData(8); }
+    bool haveSpeedData() const { return haveNavData(9); }
+    bool haveSpeedStdDev() const { return haveNavData(10); }
+    bool haveCurrentData() const { return haveNavData(11); }
+    bool haveCurrentStdDev() const { return haveNavData(12); }
+    bool haveSystemDateData() const { return haveNavData(13); }
+    bool haveINSSensorStatus() const { return haveNavData(14); }
+    bool haveINSAlgorithmStatus() const { return haveNavData(15); }
+    bool haveINSSystemStatus() const { return haveNavData(16); }
+    bool haveINSUserStatus() const { return haveNavData(17); }
+    bool haveHeaveSurgeSwaySpeedData() const { return haveNavData(21); }
+    bool haveSpeedVesselData() const { return haveNavData(22); }
+    bool haveAccelGeographicData() const { return haveNavData(23); }
+    bool haveCourseSpeedGroundData() const { return haveNavData(24); }
+    bool haveTempData() const { return haveNavData(25); }
+    bool haveAttitudeQuaternionData() const { return haveNavData(26); }
+    bool haveAttitudeQEData() const { return haveNavData(27); }
+    bool haveVesselAccel() const { return haveNavData(28); }
+    bool haveVesselAccelStdDev() const { return haveNavData(29); }
+    bool haveVesselRotationRateStdDev() const { return haveNavData(30); }
+
+    bool haveExtendedRawRotationAccelData() const { return haveExtendedNavData(0); }
+    bool haveExtendedRawRotationAccelStdDevData() const { return haveExtendedNavData(1); }
+    bool haveExtendedRawRotationRateData() const { return haveExtendedNavData(2); }
+
+    bool haveUTC() const { return haveExternData(0); }
+    bool haveGNSSInfo1() const { return haveExternData(1); }
+    bool haveGNSSInfo2() const { return haveExternData(2); }
+    bool haveGNSSInfo3() const { return haveExternData(3); }
 };
 
+static_assert(offsetof(gpsMessage, decodeErrorDetail) == 64, "hot fields of gpsMessage fill the first cache line");
+
 Q_DECLARE_METATYPE(gpsMessage)
 
-class gpsBinaryReader
+// One field to copy out of a telegram, see decodePlanCache::find()
+struct decodePlanOp {
+    uint16_t srcOffset; // from the start of the telegram
+    uint16_t dstOffset; // from the start of gpsMessage
+    uint16_t count; // number of 32-bit words for fieldRun32, otherwise 1
+    unsigned char kind; // blockFieldKinds
+};
+
+// All of the fields to decode for one combination of header bitmasks:
+struct decodePlan {
+    dword navDataBlockBitmask = 0;
+    dword extendedNavDataBlockBitmask = 0;
+    dword externDataBitMask = 0;
+    uint16_t headerSize = 0;
+    uint16_t navigationDataSize = 0;
+    uint16_t dataEnd = 0; // end of the last block decoded, from the start of the telegram
+    std::vector<decodePlanOp> ops;
+};
+
+class decodePlanCache
 {
-private:
-    void initialize();
+    std::vector<decodePlan> plans;
+    size_t lastPlanIndex = 0;
+    size_t nextPlanToReplace = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
 
-    std::mutex mtx;
+public:
+    static const size_t maxPlans = 16;
+    const decodePlan *find(dword navDataBlockBitmask, dword extendedNavDataBlockBitmask,
+                           dword externDataBitMask, uint16_t headerSize);
+    uint64_t getHits();
+    uint64_t getMisses();
+};
 
-    QByteArray rawData;
-    uint16_t dataPos;
+// Keeps track of the telegram counter to detect dropped telegrams.
+class gpsSequenceTracker
+{
+    bool firstRun = true;
     uint32_t oldCounter = 0;
-    dword priorAlgorithmStatus1 = 0;
-    bool firstRun;
-    bool decodeInvalid;
-    uint32_t messageSum;
+
+public:
+    uint32_t update(uint32_t counter); // returns the number dropped since the last counter
+    void resync(uint32_t counter); // remember the counter without checking it
+    void reset();
+};
+
+class gpsBinaryReader
+{
+private:
+    QByteArray rawData; // only holds data passed in as a QByteArray
 
     gpsMessage m;
+    decodePlanCache planCache;
+    gpsSequenceTracker sequence;
 
-    // Message Decoders:
-    void processData();
-    void detMsgType();
-    void processNavOutHeaderV2();
-    void processNavOutHeaderV3();
-    void processNavOutHeaderV5();
-    void processAltitudeHeadingData();
-    void processAltitudeHeadingStdDevData();
-
-    void processRealTimeHeaveSurgeSwayData();
-    void processSmartHeaveData();
-
-    void processHeadingRollPitchRateData();
-    void processBodyRotationRate();
-    void processAccelerationData();
-    void processPositionData();
-    void processPositionStdDevData();
-    void processSpeedData();
-    void processSpeedStdDevData();
-    void processCurrentData();
-    void processCurrentStdDevData();
-    void processSystemDateData();
-
-    void processINSSensorStatus();
-    void processINSAlgorithmStatus();
-    void processINSSystemStatus();
-    void processINSUserStatus();
-
-    void processHeaveSurgeSwaySpeed();
-
-    void processVesselVelocity();
-    void processAccelGeographic();
-    void processCourseSpeedGround();
-
-    void processTemperature();
-
-    void processAttitudeQuaternion();
-    void processAttitudeQuaternationStdDev();
-
-    void processVesselAccel();
-    void processVesselAccelStdDev();
-    void processVesselRotationRateStdDev();
-
-    // Extemded Navigation Data Blocks:
-    void processExtendedRotationAccelData();
-    void processExtendedRotationAccelStdDevData();
-    void processExtendedRawRotationRateData();
-
-    // External Data Blocks:
-    void processUTC();
-    void processGNSS(int num);
-
-    void getMessageSum();
-    bool checkMessageSum();
-
-    // Helper functions:
-    word makeWord(QByteArray, uint16_t startPos); // unsigned 16 bit int
-    short makeShort(QByteArray, uint16_t startPos); // signed 16 bit int
-    dword makeDWord(QByteArray, uint16_t startPos); // unsigned 32 bit int
-    long makeLong(QByteArray, uint16_t startPos); // signed 32 bit int
-    float makeFloat(QByteArray, uint16_t startPos); // IEEE 32 bit float
-    double makeDouble(QByteArray, uint16_t startPos); // IEEE 64 bit float
-
-    void copyQStringToCharArray(char *array, QString s);
+    void decodeRaw(const uint8_t *data, size_t length, const uint32_t *byteSum);
+    void reportDecodeStatus(gpsDecodeStatus status);
 
     unsigned char getBit(dword d, unsigned char bit);
 
 public:
     gpsBinaryReader();
-    gpsBinaryReader(QByteArray rawData);
-    void insertData(QByteArray rawData);
+    gpsBinaryReader(const QByteArray &rawData);
+
+    // Decodes one telegram into m. This keeps no state between calls,
+    // logs nothing, and may be called from any number of threads at once
+    // as long as each passes its own cache, or none. With no cache, a
+    // cache for the calling thread is used.
+    // byteSum optionally supplies the checksum already added up by the caller.
+    // numberDropped is not filled in, see gpsSequenceTracker.
+    static gpsDecodeStatus decode(const uint8_t *data, size_t length, gpsMessage &m,
+                                  decodePlanCache *cache = NULL, const uint32_t *byteSum = NULL);
+
+    // As decode(), but only the header is decoded into m. The data blocks are
+    // left for the caller, who is handed the plan for them in *plan (NULL if
+    // they cannot be decoded). Fields may then be read with decodeValue(),
+    // which does no bounds checking; all of the plan lies within the telegram
+    // when the status is decodeOK.
+    static gpsDecodeStatus decodeHeader(const uint8_t *data, size_t length, gpsMessage &m,
+                                        const decodePlan **plan, decodePlanCache *cache = NULL,
+                                        const uint32_t *byteSum = NULL);
+    static void decodeValue(unsigned char kind, const uint8_t *src, void *dst); // kind is a blockFieldKinds
+
+    // Fills in m.numberDropped from the tracker, for messages decoded
+    // with decode() in the order they were logged:
+    static void trackSequence(gpsDecodeStatus status, gpsMessage &m, gpsSequenceTracker &sequence);
+
+    // Decodes up to maxMessages telegrams from a buffer of back-to-back telegrams,
+    // skipping any bytes between them. Returns the number of entries filled in
+    // messages and statuses; bytesUsed is where decoding stopped, which is the
+    // start of any incomplete telegram at the end of the buffer.
+    // Like decode(), this logs nothing. numberDropped is filled in only if a
+    // sequence tracker is given.
+    static size_t decodeBatch(const uint8_t *data, size_t length,
+                              gpsMessage *messages, gpsDecodeStatus *statuses, size_t maxMessages,
+                              size_t *bytesUsed = NULL, decodePlanCache *cache = NULL,
+                              gpsSequenceTracker *sequence = NULL);
+    static size_t decodeBatch(const uint8_t *data, size_t length,
+                              std::vector<gpsMessage> &messages, std::vector<gpsDecodeStatus> &statuses,
+                              size_t maxMessages, size_t *bytesUsed = NULL,
+                              decodePlanCache *cache = NULL, gpsSequenceTracker *sequence = NULL);
+
+    // Size of the telegram starting at data from its header: 0 if more than
+    // available bytes are needed to tell, -1 if this is not an IX telegram.
+    static int telegramLength(const uint8_t *data, size_t available);
+    static const uint16_t maxTelegramSize = 1024;
+
+    // Text for a decode status, and for the error of a message with its detail:
+    static const char *decodeStatusText(gpsDecodeStatus status);
+    static QString decodeErrorString(const gpsMessage &m);
+
+    // Stateful interface: decode, track dropped telegrams and keep the last message.
+    // An instance must not be shared between threads.
+    void insertData(const QByteArray &rawData);
+    void insertData(const uint8_t *data, size_t length); // zero-copy decode of one telegram
+    void insertData(const uint8_t *data, size_t length, uint32_t byteSum); // with the checksum already added up
     gpsMessage getMessage();
+    gpsDecodeStatus getDecodeStatus();
 
     messageKinds getMessageType();
     uint32_t getCounter();
@@ -424,6 +486,8 @@ public:
     float getHeading();
     float getRoll();
     float getPitch();
+    uint64_t getPlanCacheHits();
+    uint64_t getPlanCacheMisses();
 
     // Utility Functions:
     QString debugString();
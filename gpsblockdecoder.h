@@ -0,0 +1,217 @@
+#ifndef GPSBLOCKDECODER_H
+#define GPSBLOCKDECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gpsbinaryreader.h"
+#include "gpsblocklayout.h"
+
+// Decoders for a fixed set of data blocks, chosen at compile time, eg:
+//
+//   typedef gpsBlockDecoder<gpsBlocks::position, gpsBlocks::attitudeQuaternion, gpsBlocks::utc> geoDecoder;
+//   geoDecoder::message m;
+//   if(geoDecoder::decode(data, length, m) == decodeOK && m.have<gpsBlocks::position>())
+//       use(m.latitude, m.longitude);
+//
+// The message holds only the header essentials and the fields of the chosen
+// blocks, under the same names as in gpsMessage. Other blocks are never read:
+// each chosen block is found from the bitmasks by offset arithmetic alone.
+
+namespace gpsBlocks {
+
+// Each block names its table and bit (see gpsblocklayout.h), and holds the
+// fields of the block in the same order and types as in gpsMessage, where
+// "first" is the first of them.
+#define GPS_BLOCK_TAG(tableNum, bitNum, first) \
+    static const int table = tableNum; \
+    static const unsigned int bit = bitNum; \
+    static constexpr uint16_t base() { return static_cast<uint16_t>(offsetof(gpsMessage, first)); }
+
+// Checks a member sits in the block struct as it does in gpsMessage:
+#define GPS_BLOCK_MEMBER(tag, first, member) \
+    static_assert(offsetof(tag::data, member) == offsetof(gpsMessage, member) - offsetof(gpsMessage, first), \
+                  #tag " layout differs from gpsMessage")
+
+// Navigation data blocks:
+
+struct attitude {
+    GPS_BLOCK_TAG(0, 0, heading)
+    struct data { float heading; float roll; float pitch; };
+};
+GPS_BLOCK_MEMBER(attitude, heading, pitch);
+
+struct attitudeStdDev {
+    GPS_BLOCK_TAG(0, 1, headingStardardDeviation)
+    struct data { float headingStardardDeviation; float rollStandardDeviation; float pitchStandardDeviation; };
+};
+GPS_BLOCK_MEMBER(attitudeStdDev, headingStardardDeviation, pitchStandardDeviation);
+
+struct headingRollPitchRate {
+    GPS_BLOCK_TAG(0, 4, headingRotationRate)
+    struct data { float headingRotationRate; float rollRotationRate; float pitchRotationRate; };
+};
+GPS_BLOCK_MEMBER(headingRollPitchRate, headingRotationRate, pitchRotationRate);
+
+struct bodyRotationRate {
+    GPS_BLOCK_TAG(0, 5, rotationRateXV1)
+    struct data { float rotationRateXV1; float rotationRateXV2; float rotationRateXV3; };
+};
+GPS_BLOCK_MEMBER(bodyRotationRate, rotationRateXV1, rotationRateXV3);
+
+struct acceleration {
+    GPS_BLOCK_TAG(0, 6, accelXV1)
+    struct data { float accelXV1; float accelXV2; float accelXV3; };
+};
+GPS_BLOCK_MEMBER(acceleration, accelXV1, accelXV3);
+
+struct position {
+    GPS_BLOCK_TAG(0, 7, latitude)
+    struct data { double latitude; double longitude; float altitude; unsigned char altitudeReference; };
+};
+GPS_BLOCK_MEMBER(position, latitude, altitudeReference);
+GPS_BLOCK_MEMBER(position, latitude, altitude);
+
+struct positionStdDev {
+    GPS_BLOCK_TAG(0, 8, northStdDev)
+    struct data { float northStdDev; float eastStdDev; float neCorrelation; float altitudStdDev; };
+};
+GPS_BLOCK_MEMBER(positionStdDev, northStdDev, altitudStdDev);
+
+struct speed {
+    GPS_BLOCK_TAG(0, 9, northVelocity)
+    struct data { float northVelocity; float eastVelocity; float upVelocity; };
+};
+GPS_BLOCK_MEMBER(speed, northVelocity, upVelocity);
+
+struct systemDate {
+    GPS_BLOCK_TAG(0, 13, systemDay)
+    struct data { unsigned char systemDay; unsigned char systemMonth; word systemYear; };
+};
+GPS_BLOCK_MEMBER(systemDate, systemDay, systemYear);
+
+struct courseSpeedGround {
+    GPS_BLOCK_TAG(0, 24, courseOverGround)
+    struct data { float courseOverGround; float speedOverGround; };
+};
+GPS_BLOCK_MEMBER(courseSpeedGround, courseOverGround, speedOverGround);
+
+struct attitudeQuaternion {
+    GPS_BLOCK_TAG(0, 26, attitudeQCq0)
+    struct data { float attitudeQCq0; float attitudeQCq1; float attitudeQCq2; float attitudeQCq3; };
+};
+GPS_BLOCK_MEMBER(attitudeQuaternion, attitudeQCq0, attitudeQCq3);
+
+// External sensor data blocks:
+
+struct utc {
+    GPS_BLOCK_TAG(2, 0, UTCdataValidityTime)
+    struct data { dword UTCdataValidityTime; unsigned char UTCSource; };
+};
+GPS_BLOCK_MEMBER(utc, UTCdataValidityTime, UTCSource);
+
+struct gnss1 {
+    GPS_BLOCK_TAG(2, 1, gnss[0])
+    struct data { gnssInfo gnss1; };
+};
+
+struct gnss2 {
+    GPS_BLOCK_TAG(2, 2, gnss[1])
+    struct data { gnssInfo gnss2; };
+};
+
+struct manualGnss {
+    GPS_BLOCK_TAG(2, 3, gnss[2])
+    struct data { gnssInfo manualGnss; };
+};
+
+#undef GPS_BLOCK_TAG
+#undef GPS_BLOCK_MEMBER
+
+} // namespace gpsBlocks
+
+template<typename... Blocks>
+class gpsBlockDecoder
+{
+public:
+    struct message : Blocks::data... {
+        bool validDecode = false;
+        dword navDataBlockBitmask = 0;
+        dword extendedNavDataBlockBitmask = 0;
+        dword externDataBitMask = 0;
+        dword navDataValidityTime = 0;
+        dword counter = 0;
+
+        // True if block B was in the telegram:
+        template<typename B> bool have() const
+        {
+            dword mask = (B::table == 0) ? navDataBlockBitmask :
+                         (B::table == 1) ? extendedNavDataBlockBitmask : externDataBitMask;
+            return (mask >> B::bit) & 1;
+        }
+    };
+
+    // As gpsBinaryReader::decode(), except that the blocks are only decoded
+    // when the status is decodeOK. Blocks not in the telegram read as zero.
+    static gpsDecodeStatus decode(const uint8_t *data, size_t length, message &m,
+                                  decodePlanCache *cache = NULL)
+    {
+        gpsMessage header;
+        const decodePlan *plan = NULL;
+        gpsDecodeStatus status = gpsBinaryReader::decodeHeader(data, length, header, &plan, cache);
+
+        m = message();
+        m.navDataBlockBitmask = header.navDataBlockBitmask;
+        m.extendedNavDataBlockBitmask = header.extendedNavDataBlockBitmask;
+        m.externDataBitMask = header.externDataBitMask;
+        m.navDataValidityTime = header.navDataValidityTime;
+        m.counter = header.counter;
+        if(status != decodeOK)
+            return status;
+
+        // Where each table's blocks start in the telegram:
+        const uint16_t starts[3] = {
+            plan->headerSize,
+            static_cast<uint16_t>(plan->headerSize + blockPayloadSize(navDataBlocks, m.navDataBlockBitmask)),
+            static_cast<uint16_t>(plan->headerSize + plan->navigationDataSize)
+        };
+        int expand[] = { 0, (decodeBlock<Blocks>(data, starts, m), 0)... };
+        (void)expand;
+
+        m.validDecode = true;
+        return status;
+    }
+
+private:
+    template<typename B> static void decodeBlock(const uint8_t *data, const uint16_t *starts, message &m)
+    {
+        static const blockLayout *tables[3] = { navDataBlocks, extendedNavDataBlocks, externDataBlocks };
+        if(!m.template have<B>())
+            return;
+
+        const blockLayout *table = tables[B::table];
+        const blockLayout &block = table[B::bit];
+        dword mask = (B::table == 0) ? m.navDataBlockBitmask :
+                     (B::table == 1) ? m.extendedNavDataBlockBitmask : m.externDataBitMask;
+        const uint8_t *src = data + starts[B::table] + blockOffset(table, mask, B::bit);
+        char *dst = reinterpret_cast<char*>(static_cast<typename B::data*>(&m));
+
+        for(int i=0; i < block.fieldCount; i++)
+        {
+            const blockField &f = block.fields[i];
+            // Flags for the block as a whole live outside of the block struct.
+            if((f.dstOffset < B::base()) || (size_t(f.dstOffset - B::base()) >= sizeof(typename B::data)))
+                continue;
+            if(f.kind == fieldFlag)
+            {
+                bool v = true;
+                memcpy(dst + f.dstOffset - B::base(), &v, sizeof(v));
+            } else {
+                gpsBinaryReader::decodeValue(f.kind, src + f.srcOffset, dst + f.dstOffset - B::base());
+            }
+        }
+    }
+};
+
+#endif // GPSBLOCKDECODER_H
@@ -0,0 +1,202 @@
+#ifndef GPSBLOCKLAYOUT_H
+#define GPSBLOCKLAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gpsbinaryreader.h"
+
+// Layout of the IX (V5) navigation, extended navigation and external
+// sensor data blocks. Each table is indexed by bit number within its
+// bitmask. A block's position in the telegram is the sum of the sizes
+// of all present blocks with a lower bit number, so any block may be
+// located directly from the bitmask.
+
+enum blockFieldKinds {
+    fieldNone = 0,
+    fieldByte,      // unsigned 8 bit int
+    fieldWord,      // unsigned 16 bit int
+    fieldDWord,     // unsigned 32 bit int
+    fieldLong,      // signed 32 bit int, stored into a long
+    fieldFloat,     // IEEE 32 bit float
+    fieldDouble,    // IEEE 64 bit float
+    fieldQuality,   // unsigned 8 bit int, stored as gpsQualityKinds
+    fieldFlag,      // no source bytes, sets a bool to true
+    fieldRun32      // decode plans only: consecutive dwords and floats
+};
+
+struct blockField {
+    blockFieldKinds kind;
+    uint16_t srcOffset; // from the start of the block
+    uint16_t dstOffset; // from the start of gpsMessage
+    const char *name; // of the gpsMessage member
+};
+
+#define BLOCK_MAX_FIELDS 16
+
+struct blockLayout {
+    bool known;
+    uint16_t sizeBytes;
+    unsigned char fieldCount;
+    blockField fields[BLOCK_MAX_FIELDS];
+};
+
+#define GPS_FIELD(kind, src, member) { kind, src, static_cast<uint16_t>(offsetof(gpsMessage, member)), #member }
+#define GPS_FLAG(member) { fieldFlag, 0, static_cast<uint16_t>(offsetof(gpsMessage, member)), #member }
+#define GPS_UNKNOWN_BLOCK { false, 0, 0, {} }
+
+#define GPS_FLOAT3_BLOCK(a, b, c) { true, 12, 3, { \
+    GPS_FIELD(fieldFloat, 0, a), GPS_FIELD(fieldFloat, 4, b), \
+    GPS_FIELD(fieldFloat, 8, c) } }
+
+#define GPS_GNSS_BLOCK(n) { true, 46, 13, { \
+    GPS_FIELD(fieldLong, 0, gnss[n].gnssDataValidityTime), \
+    GPS_FIELD(fieldByte, 4, gnss[n].gnssIdentification), \
+    GPS_FIELD(fieldByte, 5, gnss[n].gnssQuality), \
+    GPS_FIELD(fieldQuality, 5, gnss[n].gnssGPSQuality), \
+    GPS_FIELD(fieldDouble, 6, gnss[n].gnssLatitude), \
+    GPS_FIELD(fieldDouble, 14, gnss[n].gnssLongitude), \
+    GPS_FIELD(fieldFloat, 22, gnss[n].gnssAltitude), \
+    GPS_FIELD(fieldFloat, 26, gnss[n].gnssLatStdDev), \
+    GPS_FIELD(fieldFloat, 30, gnss[n].gnssLongStddev), \
+    GPS_FIELD(fieldFloat, 34, gnss[n].gnssAltStdDev), \
+    GPS_FIELD(fieldFloat, 38, gnss[n].LatLongCovariance), \
+    GPS_FIELD(fieldFloat, 42, gnss[n].geoidalSep), \
+    GPS_FLAG(gnss[n].populated) } }
+
+constexpr blockLayout navDataBlocks[32] = {
+    // Altitude and Heading (bit 0):
+    GPS_FLOAT3_BLOCK(heading, roll, pitch),
+    // Altitude and Heading standard deviation (bit 1):
+    GPS_FLOAT3_BLOCK(headingStardardDeviation, rollStandardDeviation, pitchStandardDeviation),
+    // Real time heave surge sway (bit 2):
+    { true, 16, 4, {
+          GPS_FIELD(fieldFloat, 0, rt_heave_withoutBdL), GPS_FIELD(fieldFloat, 4, rt_heave_atBdL),
+          GPS_FIELD(fieldFloat, 8, rt_surge_atBdL), GPS_FIELD(fieldFloat, 12, rt_sway_atBdL) } },
+    // Smart heave (bit 3):
+    { true, 8, 2, {
+          GPS_FIELD(fieldDWord, 0, smartHeaveValidityTime_100us), GPS_FIELD(fieldFloat, 4, smartHeave_m) } },
+    // Heading/Roll/Pitch rate (bit 4):
+    GPS_FLOAT3_BLOCK(headingRotationRate, rollRotationRate, pitchRotationRate),
+    // Body rotation rate in vessel frame (bit 5):
+    GPS_FLOAT3_BLOCK(rotationRateXV1, rotationRateXV2, rotationRateXV3),
+    // Accelerations in vessel frame (bit 6):
+    GPS_FLOAT3_BLOCK(accelXV1, accelXV2, accelXV3),
+    // Position (bit 7):
+    { true, 21, 4, {
+          GPS_FIELD(fieldDouble, 0, latitude), GPS_FIELD(fieldDouble, 8, longitude),
+          GPS_FIELD(fieldByte, 16, altitudeReference), GPS_FIELD(fieldFloat, 17, altitude) } },
+    // Position standard deviation (bit 8):
+    { true, 16, 4, {
+          GPS_FIELD(fieldFloat, 0, northStdDev), GPS_FIELD(fieldFloat, 4, eastStdDev),
+          GPS_FIELD(fieldFloat, 8, neCorrelation), GPS_FIELD(fieldFloat, 12, altitudStdDev) } },
+    // Speed in geographic frame (bit 9):
+    GPS_FLOAT3_BLOCK(northVelocity, eastVelocity, upVelocity),
+    // Speed standard deviation in geographic frame (bit 10):
+    GPS_FLOAT3_BLOCK(northVelocityStdDev, eastVelocityStdDev, upVelocityStdDev),
+    // Current in geographic frame (bit 11):
+    { true, 8, 2, {
+          GPS_FIELD(fieldFloat, 0, northCurrent), GPS_FIELD(fieldFloat, 4, eastCurrent) } },
+    // Current standard deviation in geographic frame (bit 12):
+    { true, 8, 2, {
+          GPS_FIELD(fieldFloat, 0, northCurrentStdDev), GPS_FIELD(fieldFloat, 4, eastCurrentStdDev) } },
+    // System date (bit 13):
+    { true, 4, 3, {
+          GPS_FIELD(fieldByte, 0, systemDay), GPS_FIELD(fieldByte, 1, systemMonth),
+          GPS_FIELD(fieldWord, 2, systemYear) } },
+    // INS sensor status (bit 14):
+    { true, 8, 2, {
+          GPS_FIELD(fieldDWord, 0, insSensorStatus1), GPS_FIELD(fieldDWord, 4, insSensorStatus2) } },
+    // INS algorithm status (bit 15):
+    { true, 16, 4, {
+          GPS_FIELD(fieldDWord, 0, algorithmStatus1), GPS_FIELD(fieldDWord, 4, algorithmStatus2),
+          GPS_FIELD(fieldDWord, 8, algorithmStatus3), GPS_FIELD(fieldDWord, 12, algorithmStatus4) } },
+    // INS system status (bit 16):
+    { true, 12, 3, {
+          GPS_FIELD(fieldDWord, 0, systemStatus1), GPS_FIELD(fieldDWord, 4, systemStatus2),
+          GPS_FIELD(fieldDWord, 8, systemStatus3) } },
+    // INS user status (bit 17):
+    { true, 4, 1, {
+          GPS_FIELD(fieldDWord, 0, INSuserStatus) } },
+    // Bits 18, 19, and 20 have never been received:
+    GPS_UNKNOWN_BLOCK,
+    GPS_UNKNOWN_BLOCK,
+    GPS_UNKNOWN_BLOCK,
+    // Heave surge sway speed (bit 21):
+    GPS_FLOAT3_BLOCK(realtime_heave_speed, surge_speed, sway_speed),
+    // Speed in vessel frame (bit 22):
+    GPS_FLOAT3_BLOCK(vesselXV1Velocity, vesselXV2Velocity, vesselXV3Velocity),
+    // Acceleration in geographic frame (bit 23):
+    GPS_FLOAT3_BLOCK(geographicNorthAccel, geographicEastAccel, geographicVertAccel),
+    // Course and speed over ground (bit 24):
+    { true, 8, 2, {
+          GPS_FIELD(fieldFloat, 0, courseOverGround), GPS_FIELD(fieldFloat, 4, speedOverGround) } },
+    // Temperatures (bit 25):
+    GPS_FLOAT3_BLOCK(meanTempFOG, meanTempACC, meanTempSensor),
+    // Attitude quaternion (bit 26):
+    { true, 16, 4, {
+          GPS_FIELD(fieldFloat, 0, attitudeQCq0), GPS_FIELD(fieldFloat, 4, attitudeQCq1),
+          GPS_FIELD(fieldFloat, 8, attitudeQCq2), GPS_FIELD(fieldFloat, 12, attitudeQCq3) } },
+    // Attitude quaternion standard deviation (bit 27):
+    GPS_FLOAT3_BLOCK(attitudeQE1, attitudeQE2, attitudeQE3),
+    // Raw acceleration in vessel frame (bit 28):
+    GPS_FLOAT3_BLOCK(vesselAccelXV1, vesselAccelXV2, vesselAccelXV3),
+    // Acceleration standard deviation in vessel frame (bit 29):
+    GPS_FLOAT3_BLOCK(vesselAccelXV1StdDev, vesselAccelXV2StdDev, vesselAccelXV3StdDev),
+    // Rotation rate standard deviation in vessel frame (bit 30):
+    GPS_FLOAT3_BLOCK(vesselRotationRateXV1StdDev, vesselRotationRateXV2StdDev, vesselRotationRateXV3StdDev),
+    // Bit 31 is reserved:
+    GPS_UNKNOWN_BLOCK
+};
+
+constexpr blockLayout extendedNavDataBlocks[32] = {
+    // Rotation accelerations in vessel frame (bit 0):
+    GPS_FLOAT3_BLOCK(rawRotationAccelXV1, rawRotationAccelXV2, rawRotationAccelXV3),
+    // Rotation acceleration standard deviation in vessel frame (bit 1):
+    GPS_FLOAT3_BLOCK(rawRotationAccelStdDevXV1, rawRotationAccelStdDevXV2, rawRotationAccelStdDevXV3),
+    // Raw rotation rate in vessel frame (bit 2):
+    GPS_FLOAT3_BLOCK(rawRotationRateXV1, rawRotationRateXV2, rawRotationRateXV3)
+    // All other bits are unknown.
+};
+
+constexpr blockLayout externDataBlocks[32] = {
+    // UTC (bit 0):
+    { true, 5, 2, {
+          GPS_FIELD(fieldDWord, 0, UTCdataValidityTime), GPS_FIELD(fieldByte, 4, UTCSource) } },
+    // GNSS 1, GNSS 2 and Manual GNSS (bits 1, 2, and 3):
+    GPS_GNSS_BLOCK(0),
+    GPS_GNSS_BLOCK(1),
+    GPS_GNSS_BLOCK(2)
+    // DMI, event markers, VTG and LogBook blocks are not decoded.
+};
+
+// Offset of block "bit" from the start of the first block,
+// given the bitmask of blocks present:
+constexpr uint16_t blockOffset(const blockLayout *table, dword bitmask, unsigned int bit)
+{
+    return (bit == 0) ? 0 : static_cast<uint16_t>(blockOffset(table, bitmask, bit-1)
+                                                  + (((bitmask >> (bit-1)) & 1) ? table[bit-1].sizeBytes : 0));
+}
+
+// Total size of all blocks present:
+constexpr uint16_t blockPayloadSize(const blockLayout *table, dword bitmask)
+{
+    return blockOffset(table, bitmask, 32);
+}
+
+// Bits of the mask that have a known layout:
+constexpr dword blockKnownMask(const blockLayout *table, unsigned int bit = 0)
+{
+    return (bit == 32) ? 0 : ((table[bit].known ? (dword(1) << bit) : 0) | blockKnownMask(table, bit+1));
+}
+
+constexpr dword navDataKnownMask = blockKnownMask(navDataBlocks);
+constexpr dword extendedNavDataKnownMask = blockKnownMask(extendedNavDataBlocks);
+constexpr dword externDataKnownMask = blockKnownMask(externDataBlocks);
+
+// Sanity checks against the sizes seen in real telegrams:
+static_assert(blockPayloadSize(navDataBlocks, 0x7fe3ffff) == 325, "navigation data block sizes");
+static_assert(blockPayloadSize(extendedNavDataBlocks, 0x00000007) == 36, "extended navigation data block sizes");
+static_assert(navDataKnownMask == 0x7fe3ffff, "known navigation data blocks");
+
+#endif // GPSBLOCKLAYOUT_H
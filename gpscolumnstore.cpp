@@ -0,0 +1,304 @@
+#include "gpscolumnstore.h"
+#include "gpsblocklayout.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+static const blockLayout *blockTables[3] = { navDataBlocks, extendedNavDataBlocks, externDataBlocks };
+
+static size_t valueSize(unsigned char kind)
+{
+    // Size of the decoded value in gpsMessage:
+    switch(kind)
+    {
+    case fieldByte:
+        return sizeof(unsigned char);
+    case fieldWord:
+        return sizeof(word);
+    case fieldDWord:
+        return sizeof(dword);
+    case fieldLong:
+        return sizeof(long);
+    case fieldFloat:
+        return sizeof(float);
+    case fieldDouble:
+        return sizeof(double);
+    case fieldQuality:
+        return sizeof(gpsQualityKinds);
+    default:
+        return 0;
+    }
+}
+
+static size_t bitmapWords(size_t rows)
+{
+    return (rows + 63) / 64;
+}
+
+gpsColumnStore::gpsColumnStore()
+{
+    columnAt.assign(sizeof(gpsMessage), -1);
+}
+
+gpsColumnStore::~gpsColumnStore()
+{
+    for(size_t i=0; i < columns.size(); i++)
+        free(columns[i].data);
+    for(size_t i=0; i < bitmaps.size(); i++)
+        free(bitmaps[i].bits);
+    free(counterColumn);
+    free(timeColumn);
+}
+
+bool gpsColumnStore::addColumn(uint16_t memberOffset)
+{
+    if(memberOffset >= columnAt.size())
+        return false;
+    if(columnAt[memberOffset] >= 0)
+        return true;
+
+    for(unsigned char table=0; table < 3; table++)
+    {
+        for(unsigned char bit=0; bit < 32; bit++)
+        {
+            const blockLayout &block = blockTables[table][bit];
+            for(int f=0; f < block.fieldCount; f++)
+            {
+                if((block.fields[f].dstOffset != memberOffset) || (block.fields[f].kind == fieldFlag))
+                    continue;
+
+                columnInfo c;
+                c.memberOffset = memberOffset;
+                c.kind = block.fields[f].kind;
+                c.elementSize = valueSize(c.kind);
+
+                c.bitmap = bitmaps.size();
+                for(size_t b=0; b < bitmaps.size(); b++)
+                {
+                    if((bitmaps[b].table == table) && (bitmaps[b].bit == bit))
+                        c.bitmap = b;
+                }
+                if(c.bitmap == bitmaps.size())
+                {
+                    blockBitmap bm;
+                    bm.table = table;
+                    bm.bit = bit;
+                    bm.bits = (uint64_t*)allocColumn(bitmapWords(capacity) * sizeof(uint64_t));
+                    bitmaps.push_back(bm);
+                }
+
+                c.data = (uint8_t*)allocColumn(capacity * c.elementSize);
+                columnAt[memberOffset] = columns.size();
+                columns.push_back(c);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t gpsColumnStore::columnCount()
+{
+    return columns.size();
+}
+
+bool gpsColumnStore::findField(const std::string &name, uint16_t *memberOffset)
+{
+    for(unsigned char table=0; table < 3; table++)
+    {
+        for(unsigned char bit=0; bit < 32; bit++)
+        {
+            const blockLayout &block = blockTables[table][bit];
+            for(int f=0; f < block.fieldCount; f++)
+            {
+                if((block.fields[f].kind != fieldFlag) && (name == block.fields[f].name))
+                {
+                    *memberOffset = block.fields[f].dstOffset;
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> gpsColumnStore::fieldNames()
+{
+    std::vector<std::string> names;
+    for(unsigned char table=0; table < 3; table++)
+    {
+        for(unsigned char bit=0; bit < 32; bit++)
+        {
+            const blockLayout &block = blockTables[table][bit];
+            for(int f=0; f < block.fieldCount; f++)
+            {
+                // The same blocks turn up in each protocol version's table:
+                if((block.fields[f].kind != fieldFlag) &&
+                        (std::find(names.begin(), names.end(), block.fields[f].name) == names.end()))
+                    names.push_back(block.fields[f].name);
+            }
+        }
+    }
+    return names;
+}
+
+gpsDecodeStatus gpsColumnStore::append(const uint8_t *data, size_t length, decodePlanCache *cache,
+                                       const uint32_t *byteSum)
+{
+    const decodePlan *plan = NULL;
+    gpsDecodeStatus status = gpsBinaryReader::decodeHeader(data, length, header, &plan, cache, byteSum);
+    if(status != decodeOK)
+        return status;
+
+    if(rows == capacity)
+        grow(capacity ? 2*capacity : 1024);
+    size_t row = rows;
+
+    counterColumn[row] = header.counter;
+    timeColumn[row] = header.navDataValidityTime;
+    for(size_t i=0; i < columns.size(); i++)
+        memset(columns[i].data + row*columns[i].elementSize, 0x0, columns[i].elementSize);
+
+    // Only the selected fields are decoded, each straight into its column:
+    const int16_t *at = columnAt.data();
+    const decodePlanOp *ops = plan->ops.data();
+    size_t count = plan->ops.size();
+    for(size_t i=0; i < count; i++)
+    {
+        const decodePlanOp &op = ops[i];
+        if(op.kind == fieldRun32)
+        {
+            for(uint16_t w=0; w < op.count; w++)
+            {
+                int16_t c = at[op.dstOffset + 4*w];
+                if(c >= 0)
+                    gpsBinaryReader::decodeValue(fieldDWord, data + op.srcOffset + 4*w,
+                                                 columns[c].data + row*4);
+            }
+        } else if(op.kind != fieldFlag) {
+            int16_t c = at[op.dstOffset];
+            if(c >= 0)
+                gpsBinaryReader::decodeValue(op.kind, data + op.srcOffset,
+                                             columns[c].data + row*columns[c].elementSize);
+        }
+    }
+
+    dword masks[3] = { header.navDataBlockBitmask, header.extendedNavDataBlockBitmask, header.externDataBitMask };
+    for(size_t b=0; b < bitmaps.size(); b++)
+    {
+        if((masks[bitmaps[b].table] >> bitmaps[b].bit) & 1)
+            bitmaps[b].bits[row / 64] |= uint64_t(1) << (row % 64);
+    }
+
+    rows++;
+    return status;
+}
+
+size_t gpsColumnStore::rowCount()
+{
+    return rows;
+}
+
+void gpsColumnStore::reserve(size_t rows)
+{
+    if(rows > capacity)
+        grow(rows);
+}
+
+void gpsColumnStore::clear()
+{
+    for(size_t b=0; b < bitmaps.size(); b++)
+        memset(bitmaps[b].bits, 0x0, bitmapWords(capacity) * sizeof(uint64_t));
+    rows = 0;
+}
+
+const dword *gpsColumnStore::counters()
+{
+    return counterColumn;
+}
+
+const dword *gpsColumnStore::validityTimes()
+{
+    return timeColumn;
+}
+
+const gpsColumnStore::columnInfo *gpsColumnStore::findColumn(uint16_t memberOffset)
+{
+    if((memberOffset >= columnAt.size()) || (columnAt[memberOffset] < 0))
+        return NULL;
+    return &columns[columnAt[memberOffset]];
+}
+
+const void *gpsColumnStore::column(uint16_t memberOffset)
+{
+    const columnInfo *c = findColumn(memberOffset);
+    return c ? c->data : NULL;
+}
+
+size_t gpsColumnStore::elementSize(uint16_t memberOffset)
+{
+    const columnInfo *c = findColumn(memberOffset);
+    return c ? c->elementSize : 0;
+}
+
+unsigned char gpsColumnStore::kind(uint16_t memberOffset)
+{
+    const columnInfo *c = findColumn(memberOffset);
+    return c ? c->kind : (unsigned char)fieldNone;
+}
+
+const uint64_t *gpsColumnStore::validity(uint16_t memberOffset)
+{
+    const columnInfo *c = findColumn(memberOffset);
+    return c ? bitmaps[c->bitmap].bits : NULL;
+}
+
+bool gpsColumnStore::isValid(uint16_t memberOffset, size_t row)
+{
+    const uint64_t *bits = validity(memberOffset);
+    if((bits == NULL) || (row >= rows))
+        return false;
+    return (bits[row / 64] >> (row % 64)) & 1;
+}
+
+void gpsColumnStore::grow(size_t newCapacity)
+{
+    for(size_t i=0; i < columns.size(); i++)
+    {
+        columns[i].data = (uint8_t*)resizeColumn(columns[i].data, capacity * columns[i].elementSize,
+                                                 newCapacity * columns[i].elementSize);
+    }
+    for(size_t b=0; b < bitmaps.size(); b++)
+    {
+        bitmaps[b].bits = (uint64_t*)resizeColumn(bitmaps[b].bits, bitmapWords(capacity) * sizeof(uint64_t),
+                                                  bitmapWords(newCapacity) * sizeof(uint64_t));
+    }
+    counterColumn = (dword*)resizeColumn(counterColumn, capacity * sizeof(dword), newCapacity * sizeof(dword));
+    timeColumn = (dword*)resizeColumn(timeColumn, capacity * sizeof(dword), newCapacity * sizeof(dword));
+    capacity = newCapacity;
+}
+
+void *gpsColumnStore::allocColumn(size_t bytes)
+{
+    // Zeroed, and rounded up to whole cache lines so that
+    // vector loads may run off the end of the last row.
+    void *p = NULL;
+    bytes = (bytes + alignment - 1) & ~(alignment - 1);
+    if(bytes == 0)
+        bytes = alignment;
+    if(posix_memalign(&p, alignment, bytes) != 0)
+        return NULL;
+    memset(p, 0x0, bytes);
+    return p;
+}
+
+void *gpsColumnStore::resizeColumn(void *old, size_t oldBytes, size_t newBytes)
+{
+    void *p = allocColumn(newBytes);
+    if((p != NULL) && (old != NULL))
+        memcpy(p, old, oldBytes < newBytes ? oldBytes : newBytes);
+    free(old);
+    return p;
+}
@@ -0,0 +1,98 @@
+#ifndef GPSCOLUMNSTORE_H
+#define GPSCOLUMNSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "gpsbinaryreader.h"
+
+// Names a gpsMessage member as a column, for example GPS_COLUMN(heading):
+#define GPS_COLUMN(member) static_cast<uint16_t>(offsetof(gpsMessage, member))
+
+// Decoded navigation data stored by field instead of by message.
+// Each selected field is one contiguous, cache-line-aligned array
+// holding one entry per telegram, in the same type as the gpsMessage
+// member. Each data block has a bitmap of the rows it was present in;
+// fields of absent blocks read as zero.
+// Telegrams are decoded straight into the columns, and fields that
+// were not selected are never read. Only telegrams that decode
+// without error are added.
+class gpsColumnStore
+{
+public:
+    static const size_t alignment = 64;
+
+    gpsColumnStore();
+    ~gpsColumnStore();
+
+    // Returns false if the member is not a field of a known data block.
+    // Columns added after rows have been appended read as zero for those rows.
+    bool addColumn(uint16_t memberOffset);
+    size_t columnCount();
+
+    // Fields by the name of their gpsMessage member, such as "heading"
+    // or "gnss[0].gnssLatitude":
+    static bool findField(const std::string &name, uint16_t *memberOffset);
+    static std::vector<std::string> fieldNames(); // in telegram block order
+
+    // byteSum optionally supplies the checksum already added up, as for gpsBinaryReader::decode():
+    gpsDecodeStatus append(const uint8_t *data, size_t length, decodePlanCache *cache = NULL,
+                           const uint32_t *byteSum = NULL);
+
+    size_t rowCount();
+    void reserve(size_t rows);
+    void clear(); // removes the rows, keeps the columns
+
+    // Header fields, always stored:
+    const dword *counters();
+    const dword *validityTimes();
+
+    // NULL if the column was not added, or for column<T>(), if T is the wrong size:
+    const void *column(uint16_t memberOffset);
+    template<typename T> const T *column(uint16_t memberOffset)
+    {
+        return (elementSize(memberOffset) == sizeof(T)) ? static_cast<const T*>(column(memberOffset)) : NULL;
+    }
+    size_t elementSize(uint16_t memberOffset);
+    unsigned char kind(uint16_t memberOffset); // blockFieldKinds, fieldNone if the column was not added
+
+    // Presence of the block holding the field: bit (row % 64) of word (row / 64).
+    const uint64_t *validity(uint16_t memberOffset);
+    bool isValid(uint16_t memberOffset, size_t row);
+
+private:
+    Q_DISABLE_COPY(gpsColumnStore)
+
+    struct columnInfo {
+        uint16_t memberOffset;
+        unsigned char kind; // blockFieldKinds
+        unsigned char elementSize;
+        size_t bitmap; // index into bitmaps
+        uint8_t *data;
+    };
+
+    // One per data block with a selected field:
+    struct blockBitmap {
+        unsigned char table; // 0 navigation, 1 extended navigation, 2 external
+        unsigned char bit;
+        uint64_t *bits;
+    };
+
+    std::vector<columnInfo> columns;
+    std::vector<blockBitmap> bitmaps;
+    std::vector<int16_t> columnAt; // column index by gpsMessage offset, -1 for none
+    dword *counterColumn = NULL;
+    dword *timeColumn = NULL;
+    size_t rows = 0;
+    size_t capacity = 0;
+    gpsMessage header;
+
+    const columnInfo *findColumn(uint16_t memberOffset);
+    void grow(size_t newCapacity);
+    static void *allocColumn(size_t bytes);
+    static void *resizeColumn(void *old, size_t oldBytes, size_t newBytes);
+};
+
+#endif // GPSCOLUMNSTORE_H
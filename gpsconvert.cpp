@@ -0,0 +1,157 @@
+#include "gpscolumnstore.h"
+#include "gpslogconverter.h"
+#include "gpslogindex.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QTime>
+
+// Converts a binary A7 log to CSV or to a columnar file, without the GUI,
+// or writes the sidecar index that lets a raw log be seeked quickly.
+
+static int64_t parseTime(const QString &text, bool *ok)
+{
+    // H:mm:ss[.zzz] UTC, to navDataValidityTime:
+    QTime t = QTime::fromString(text, "H:mm:ss.zzz");
+    if(!t.isValid())
+        t = QTime::fromString(text, "H:mm:ss");
+    *ok = t.isValid();
+    return t.isValid() ? (int64_t)t.msecsSinceStartOfDay() * 10 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("gpsconvert");
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts a binary A7 log to CSV or to a columnar file.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Binary log, raw or container.");
+    parser.addPositionalArgument("output", "Output file, - for stdout.");
+    QCommandLineOption formatOption(QStringList() << "f" << "format", "csv or columnar.", "format", "csv");
+    QCommandLineOption fieldsOption("fields", "Comma separated fields to convert.", "fields",
+                                    "latitude,longitude,altitude,heading,roll,pitch");
+    QCommandLineOption listOption("list-fields", "Lists the fields that can be converted.");
+    QCommandLineOption fromOption("from", "Start at this UTC time.", "H:mm:ss[.zzz]");
+    QCommandLineOption toOption("to", "Stop after this UTC time.", "H:mm:ss[.zzz]");
+    QCommandLineOption everyOption("every", "Keep every n-th telegram in range.", "n", "1");
+    QCommandLineOption indexOption("index", "Writes or brings up to date the sidecar index of a raw log, instead of converting it.");
+    parser.addOption(formatOption);
+    parser.addOption(fieldsOption);
+    parser.addOption(listOption);
+    parser.addOption(fromOption);
+    parser.addOption(toOption);
+    parser.addOption(everyOption);
+    parser.addOption(indexOption);
+    parser.process(a);
+
+    if(parser.isSet(listOption))
+    {
+        QTextStream out(stdout);
+        std::vector<std::string> names = gpsColumnStore::fieldNames();
+        for(size_t i=0; i < names.size(); i++)
+            out << names[i].c_str() << "\n";
+        return 0;
+    }
+
+    QStringList args = parser.positionalArguments();
+    if(parser.isSet(indexOption) && (args.size() == 1))
+    {
+        std::string path = args[0].toStdString();
+        gpsLogIndex index;
+        int error = index.load(path);
+        if((error == 0) && index.isContainer())
+        {
+            err << args[0] << " is a container log, which carries its own index\n";
+            return 0;
+        }
+        if((error == 0) || (error == ENOENT))
+            error = gpsLogIndex::buildSidecar(path);
+        if(error == 0)
+            error = index.load(path);
+        if(error != 0)
+        {
+            err << "Error indexing " << args[0] << ": " << strerror(error) << "\n";
+            return 1;
+        }
+        err << QString("%1: %2 entries, covering %3 bytes\n")
+               .arg(QString::fromStdString(gpsLogIndex::sidecarPath(path))).arg(index.size())
+               .arg(index.getCoveredBytes());
+        return 0;
+    }
+    if(args.size() != 2)
+        parser.showHelp(1);
+
+    gpsLogConverter converter;
+    QString format = parser.value(formatOption);
+    if(format == "columnar")
+    {
+        converter.setFormat(gpsLogConverter::formatColumnar);
+    } else if(format != "csv")
+    {
+        err << "Unknown format " << format << "\n";
+        return 1;
+    }
+
+    QStringList fields = parser.value(fieldsOption).split(',');
+    for(int i=0; i < fields.size(); i++)
+    {
+        if(fields[i].trimmed().isEmpty())
+            continue;
+        if(!converter.addField(fields[i].trimmed().toStdString()))
+        {
+            err << "Unknown field " << fields[i] << ", see --list-fields\n";
+            return 1;
+        }
+    }
+
+    bool ok = true;
+    int64_t from = -1;
+    int64_t to = -1;
+    if(parser.isSet(fromOption))
+        from = parseTime(parser.value(fromOption), &ok);
+    if(ok && parser.isSet(toOption))
+        to = parseTime(parser.value(toOption), &ok);
+    if(!ok)
+    {
+        err << "Times are H:mm:ss or H:mm:ss.zzz\n";
+        return 1;
+    }
+    converter.setTimeRange(from, to);
+
+    uint every = parser.value(everyOption).toUInt(&ok);
+    if(!ok || (every == 0))
+    {
+        err << "--every needs a number of 1 or more\n";
+        return 1;
+    }
+    converter.setDecimation(every);
+
+    int error = converter.run(args[0].toStdString(), args[1].toStdString());
+    if(error != 0)
+    {
+        err << "Error converting " << args[0] << ": " << strerror(error) << "\n";
+        return 1;
+    }
+
+    double seconds = converter.getSeconds();
+    double mbytes = converter.getBytesRead() / 1E6;
+    err << QString("Read %1 MB, %2 telegrams (%3 decode errors), wrote %4 rows, %5 MB in %6 s\n")
+           .arg(mbytes, 0, 'f', 1).arg(converter.getTelegrams()).arg(converter.getDecodeErrors())
+           .arg(converter.getRowsWritten()).arg(converter.getBytesWritten() / 1E6, 0, 'f', 1)
+           .arg(seconds, 0, 'f', 2);
+    if(seconds > 0)
+        err << QString("%1 MB/s, %2 telegrams/s\n")
+               .arg(mbytes / seconds, 0, 'f', 1).arg(converter.getTelegrams() / seconds, 0, 'f', 0);
+    err << QString("Busy: read %1 s, decode %2 s, format %3 s\n")
+           .arg(converter.getReadSeconds(), 0, 'f', 2).arg(converter.getDecodeSeconds(), 0, 'f', 2)
+           .arg(converter.getFormatSeconds(), 0, 'f', 2);
+    return 0;
+}
@@ -0,0 +1,18 @@
+QT       = core
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = gpsconvert
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+QMAKE_CXXFLAGS += -Wno-class-memaccess
+
+include(gpscore.pri)
+
+SOURCES += \
+    gpsconvert.cpp
+
+unix:!android: target.path = /opt/gpsconvert/bin
+!isEmpty(target.path): INSTALLS += target
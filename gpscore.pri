@@ -0,0 +1,12 @@
+# For programs using libgpscore: include(gpscore.pri), and build after
+# gpscore.pro, as gps.pro does.
+
+QT += core network
+
+INCLUDEPATH += $$PWD
+
+# As for the library, so off_t is the same size on both sides:
+unix:DEFINES += _FILE_OFFSET_BITS=64
+
+LIBS += -L$$OUT_PWD -lgpscore
+unix:PRE_TARGETDEPS += $$OUT_PWD/libgpscore.a
@@ -0,0 +1,56 @@
+# libgpscore: decoding, replay, the network connection and logging, for
+# gpsGUI and for headless programs. Needs only QtCore and QtNetwork.
+
+QT       = core network
+
+TEMPLATE = lib
+CONFIG += c++11 staticlib
+TARGET = gpscore
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+QMAKE_CXXFLAGS += -Wno-class-memaccess
+
+# 64 bit file offsets, for logs over 2 GB on 32 bit builds:
+unix:DEFINES += _FILE_OFFSET_BITS=64
+
+SOURCES += \
+    gpsbinaryfilereader.cpp \
+    gpsbinarylogger.cpp \
+    gpsbinaryreader.cpp \
+    gpscolumnstore.cpp \
+    gpslogcontainer.cpp \
+    gpslogconverter.cpp \
+    gpslogfile.cpp \
+    gpslogindex.cpp \
+    gpslogseeker.cpp \
+    gpsmappedfile.cpp \
+    gpsnetwork.cpp \
+    gpsparalleldecoder.cpp \
+    gpsreceivering.cpp \
+    gpsreplayclock.cpp \
+    gpssimd.cpp \
+    gpstelegramframer.cpp \
+    gpsuringwriter.cpp
+
+HEADERS += \
+    gpsbinaryfilereader.h \
+    gpsbinarylogger.h \
+    gpsbinaryreader.h \
+    gpsblockdecoder.h \
+    gpsblocklayout.h \
+    gpscolumnstore.h \
+    gpslogcontainer.h \
+    gpslogconverter.h \
+    gpslogfile.h \
+    gpslogindex.h \
+    gpslogseeker.h \
+    gpsmappedfile.h \
+    gpsnetwork.h \
+    gpsparalleldecoder.h \
+    gpsreceivering.h \
+    gpsreplayclock.h \
+    gpsspscqueue.h \
+    gpssimd.h \
+    gpstelegramframer.h \
+    gpsuringwriter.h
@@ -53,6 +53,7 @@ GpsGui::GpsGui(QWidget *parent)
     firstMessage = true;
 
     qRegisterMetaType<gpsMessage>();
+    qRegisterMetaType<gpsMessageBatch>("gpsMessageBatch");
 
     gps = new gpsNetwork();
     gpsThread = new QThread(this);
@@ -62,6 +63,7 @@ GpsGui::GpsGui(QWidget *parent)
     connect(gpsThread, &QThread::finished, gps, &QObject::deleteLater);
 
     fileReader = new gpsBinaryFileReader();
+    fileReader->setMappedMode(ui->mappedReadChk->isChecked());
     replayThread = new QThread(this);
     fileReader->moveToThread(replayThread);
     connect(replayThread, &QThread::finished, fileReader, &QObject::deleteLater);
@@ -87,9 +89,10 @@ GpsGui::GpsGui(QWidget *parent)
     connect(fileReader, SIGNAL(haveErrorMessage(QString)), this, SLOT(handleErrorMessage(QString)));
     connect(fileReader, SIGNAL(haveStatusMessage(QString)), this, SLOT(handleGPSStatusMessage(QString)));
     connect(fileReader, SIGNAL(haveGPSMessage(gpsMessage)), this, SLOT(receiveGPSMessage(gpsMessage)));
+    connect(fileReader, SIGNAL(haveGPSMessageBatch(gpsMessageBatch)), this, SLOT(receiveGPSMessageBatch(gpsMessageBatch)));
+    connect(fileReader, SIGNAL(haveReplayPosition(double)), this, SLOT(handleReplayPosition(double)));
     connect(this, SIGNAL(startGPSReplay()), fileReader, SLOT(beginWork()));
     connect(this, SIGNAL(stopGPSReplay()), fileReader, SLOT(stopWork()));
-    connect(this, SIGNAL(setGPSReplaySpeedupFactor(int)), fileReader, SLOT(setSpeedupFactor(int)));
     replayThread->start();
 
     ui->gpsPort->setValidator( new QIntValidator(0,65535,this) );
@@ -163,16 +166,31 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
         //firstMessage = false; // set at end of function.
     }
 
-    bool doPlotUpdate = ((msgsReceivedCount%40)==0) && ui->drawWidgetsChk->isChecked();
+    bool doPlotSample = ((msgsReceivedCount%40)==0) && ui->drawWidgetsChk->isChecked();
+    bool doPlotUpdate = doPlotSample;
     bool doWidgetPaint = ((msgsReceivedCount%51)==0) && ui->drawWidgetsChk->isChecked();
     bool doLabelUpdate = (msgsReceivedCount%10)==0;
     bool doMapUpdate = ((msgsReceivedCount%50)==0) && ui->drawWidgetsChk->isChecked();
+    if(batchPosition == insideBatch)
+    {
+        // Plots still take every 40th, so they span the same time:
+        doPlotUpdate = false;
+        doWidgetPaint = false;
+        doLabelUpdate = false;
+        doMapUpdate = false;
+    } else if(batchPosition == lastInBatch)
+    {
+        doPlotUpdate = ui->drawWidgetsChk->isChecked();
+        doWidgetPaint = ui->drawWidgetsChk->isChecked();
+        doLabelUpdate = true;
+        doMapUpdate = ui->drawWidgetsChk->isChecked();
+    }
 
 
     gpsMessageHeartbeat.start();
 
 
-    if(m.haveINSAlgorithmStatus)
+    if(m.haveINSAlgorithmStatus())
     {
         if( (m.algorithmStatus1 == priorAlgorithmStatus1) && (!firstMessage))
         {
@@ -286,7 +304,7 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
         }
     }
 
-    if(m.haveINSSystemStatus)
+    if(m.haveINSSystemStatus())
     {
         if(getBit(m.systemStatus1, 17)) {
             ui->outputAFullStatus->setState(QLedLabel::StateError);
@@ -319,19 +337,19 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
         doStickyUpdate = true;
     }
 
-    if(m.haveGNSSInfo1 || m.haveGNSSInfo2 || m.haveGNSSInfo3)
+    if(m.haveGNSSInfo1() || m.haveGNSSInfo2() || m.haveGNSSInfo3())
     {
         gnssStatusTime.restart();
 
-        if(m.haveGNSSInfo1)
+        if(m.haveGNSSInfo1())
         {
             processGNSSInfo(1);
         }
-        if(m.haveGNSSInfo2)
+        if(m.haveGNSSInfo2())
         {
             processGNSSInfo(2);
         }
-        if(m.haveGNSSInfo3)
+        if(m.haveGNSSInfo3())
         {
             processGNSSInfo(3);
         }
@@ -381,7 +399,7 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
     }
 
 
-    if(m.haveAltitudeHeading)
+    if(m.haveAltitudeHeading())
     {
         if(doLabelUpdate)
         {
@@ -391,7 +409,7 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
         }
 
         // Store for plots:
-        if(doPlotUpdate)
+        if(doPlotSample)
         {
             //uint16_t vecPosAltHeadingMod = (vecPosAltHeading++) % vecSize;
 
@@ -414,7 +432,7 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
         ui->EHSI->setBearing(m.heading);
     }
 
-    if(m.havePosition)
+    if(m.havePosition())
     {
         if(m.longitude > 180)
         {
@@ -437,7 +455,7 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
         }
         ui->EADI->setAltitude(m.altitude);
 
-        if(doPlotUpdate)
+        if(doPlotSample)
         {
             //uint16_t vecPosPositionMod = (vecPosPosition++) % vecSize;
 
@@ -453,7 +471,7 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
 
     }
 
-    if(m.haveCourseSpeedGroundData)
+    if(m.haveCourseSpeedGroundData())
     {
         if(m.speedOverGround > 0.1)
             ui->EHSI->setCourse(m.courseOverGround);
@@ -471,13 +489,13 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
                 }
             }
         }
-        if(doPlotUpdate)
+        if(doPlotSample)
         {
             groundVelos.push_front(m.speedOverGround);
             groundVelos.pop_back();
         }
     }
-    if(m.haveSpeedData)
+    if(m.haveSpeedData())
     {
         ui->verticalSpeedIndicator->setClimbRate(m.upVelocity * 196.85); // 1 meter per second = 196.85 feet per 100 minutes
         ui->EADI->setClimbRate(m.upVelocity * 196.85);
@@ -488,9 +506,9 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
         }
     }
 
-    if(m.haveSpeedData)
+    if(m.haveSpeedData())
     {
-        if(doPlotUpdate)
+        if(doPlotSample)
         {
             //uint16_t vecPosSpeedMod = (vecPosSpeed++) % vecSize;
 
@@ -506,13 +524,13 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
 
     }
 
-    if(m.haveSystemDateData)
+    if(m.haveSystemDateData() && (batchPosition != insideBatch))
     {
         QString date = QString("%1-%2-%3").arg(m.systemYear).arg(m.systemMonth, 2, 10, QChar('0')).arg(m.systemDay, 2, 10, QChar('0'));
         ui->utcDateLabel->setText(date);
     }
 
-    if(m.haveUTC)
+    if(m.haveUTC() && (batchPosition != insideBatch))
     {
         // This message is available every second, unless there is a
         // skip counter issue occuring, in which case it is skipped.
@@ -555,7 +573,7 @@ void GpsGui::receiveGPSMessage(gpsMessage m)
     if(doPlotUpdate)
         updatePlots();
 
-    if(doStickyUpdate)
+    if((doStickyUpdate && (batchPosition != insideBatch)) || (batchPosition == lastInBatch))
         processStickyStatus();
 
     if(firstMessage)
@@ -681,6 +699,19 @@ void GpsGui::setPlotColors(QCustomPlot *p, bool dark)
     }
 }
 
+void GpsGui::receiveGPSMessageBatch(gpsMessageBatch batch)
+{
+    // From a bulk replay. Every message goes through receiveGPSMessage()
+    // for the status and plot data, but the labels, widgets and plots are
+    // drawn once, for the last one.
+    for(size_t i=0; i < batch->size(); i++)
+    {
+        batchPosition = (i+1 < batch->size()) ? insideBatch : lastInBatch;
+        receiveGPSMessage(batch->at(i));
+    }
+    batchPosition = notInBatch;
+}
+
 void GpsGui::updatePlots()
 {
     // Called when there are new data
@@ -1007,13 +1038,24 @@ void GpsGui::on_stopSecondLogBtn_clicked()
     emit stopSecondaryLog();
 }
 
-void GpsGui::on_speedupFactorSpin_valueChanged(int arg1)
+void GpsGui::on_speedupFactorSpin_valueChanged(double arg1)
 {
+    // Called directly, as the replay thread is busy in beginWork():
     if(arg1 > 0)
-    {
-        fileReader->messageDelayMicroSeconds = (1E6 / 200.0) / arg1;
-        emit setGPSReplaySpeedupFactor(arg1);
-    }
+        fileReader->setSpeedupFactor(arg1);
+}
+
+void GpsGui::on_bulkReplayChk_toggled(bool checked)
+{
+    // Called directly, as the replay thread is busy in beginWork():
+    fileReader->setBulkMode(checked);
+    ui->speedupFactorSpin->setEnabled(!checked);
+}
+
+void GpsGui::on_mappedReadChk_toggled(bool checked)
+{
+    // Called directly, used from the next replay on:
+    fileReader->setMappedMode(checked);
 }
 
 void GpsGui::on_replayEnabledChk_toggled(bool checked)
@@ -1025,3 +1067,28 @@ void GpsGui::on_replayEnabledMainChk_toggled(bool checked)
 {
     fileReader->paused = !checked;
 }
+
+void GpsGui::handleReplayPosition(double fraction)
+{
+    // Leave the slider alone while it is being dragged:
+    if(!ui->replayScrubSlider->isSliderDown())
+        ui->replayScrubSlider->setValue(fraction * ui->replayScrubSlider->maximum());
+}
+
+void GpsGui::on_replayScrubSlider_sliderReleased()
+{
+    // Called directly, as the replay thread is busy in beginWork():
+    fileReader->seekToFraction((double)ui->replayScrubSlider->value() / ui->replayScrubSlider->maximum());
+}
+
+void GpsGui::on_seekTimeEdit_editingFinished()
+{
+    QTime t = QTime::fromString(ui->seekTimeEdit->text(), "H:mm:ss");
+    if(!t.isValid())
+    {
+        handleErrorMessage(QString("Cannot seek to [%1], expected UTC as hh:mm:ss.").arg(ui->seekTimeEdit->text()));
+        return;
+    }
+    // navDataValidityTime is in 100 us since midnight UTC:
+    fileReader->seekToTime(t.msecsSinceStartOfDay() * 10);
+}
@@ -7,6 +7,7 @@
 #include <QThread>
 #include <QIntValidator>
 #include <QElapsedTimer>
+#include <QTime>
 
 
 #ifdef __APPLE__
@@ -78,6 +79,14 @@ class GpsGui : public QMainWindow
     QElapsedTimer gnssStatusTime;
     bool firstMessage;
 
+    // Within a batch from a bulk replay, only the last message is drawn:
+    enum batchPositions {
+        notInBatch,
+        insideBatch,
+        lastInBatch
+    };
+    batchPositions batchPosition = notInBatch;
+
     void showStatusMessage(QString);
 
 public:
@@ -86,6 +95,7 @@ public:
 
 public slots:
     void receiveGPSMessage(gpsMessage m);
+    void receiveGPSMessageBatch(gpsMessageBatch batch);
     void handleErrorMessage(QString);
 
 signals:
@@ -96,7 +106,6 @@ signals:
     void setBinaryLogReplayFilename(QString replayFilename);
     void startGPSReplay();
     void stopGPSReplay();
-    void setGPSReplaySpeedupFactor(int factor);
     void sendMapCoordinates(double lat, double lng);
     void sendMapRotation(float angle);
     void startSecondaryLog(QString secondaryLogFilename);
@@ -132,12 +141,21 @@ private slots:
 
     void on_stopSecondLogBtn_clicked();
 
-    void on_speedupFactorSpin_valueChanged(int arg1);
+    void on_speedupFactorSpin_valueChanged(double arg1);
+
+    void on_bulkReplayChk_toggled(bool checked);
+    void on_mappedReadChk_toggled(bool checked);
 
     void on_replayEnabledChk_toggled(bool checked);
 
     void on_replayEnabledMainChk_toggled(bool checked);
 
+    void handleReplayPosition(double fraction);
+
+    void on_replayScrubSlider_sliderReleased();
+
+    void on_seekTimeEdit_editingFinished();
+
 private:
     Ui::GpsGui *ui;
     dword priorAlgorithmStatus1 = 0;
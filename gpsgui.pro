@@ -21,13 +21,11 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 QMAKE_CXXFLAGS += -Wno-class-memaccess
 
+include(gpscore.pri)
+
 linux:LIBS += -lqcustomplot
 
 SOURCES += \
-    gpsbinaryfilereader.cpp \
-    gpsbinarylogger.cpp \
-    gpsbinaryreader.cpp \
-    gpsnetwork.cpp \
     main.cpp \
     gpsgui.cpp \
     mapview.cpp \
@@ -36,11 +34,7 @@ SOURCES += \
 macx:SOURCES += qcustomplot-source/qcustomplot.cpp
 
 HEADERS += \
-    gpsbinaryfilereader.h \
-    gpsbinarylogger.h \
-    gpsbinaryreader.h \
     gpsgui.h \
-    gpsnetwork.h \
     mapview.h \
     qledlabel.h
 
@@ -0,0 +1,253 @@
+#include "gpslogcontainer.h"
+#include "gpsbinaryreader.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+static void putLE(uint8_t *dst, uint64_t value, size_t bytes)
+{
+    for(size_t i=0; i < bytes; i++)
+    {
+        dst[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+static uint64_t getLE(const uint8_t *src, size_t bytes)
+{
+    uint64_t value = 0;
+    for(size_t i=bytes; i > 0; i--)
+        value = (value << 8) | src[i-1];
+    return value;
+}
+
+// Format:
+
+void gpsContainer::putRecordHeader(uint8_t *dst, uint16_t kind, uint32_t length, int64_t time)
+{
+    dst[0] = 'G';
+    dst[1] = 'C';
+    putLE(dst + 2, kind, 2);
+    putLE(dst + 4, length, 4);
+    putLE(dst + 8, (uint64_t)time, 8);
+}
+
+bool gpsContainer::getRecordHeader(const uint8_t *src, gpsRecordHeader &header)
+{
+    if((src[0] != 'G') || (src[1] != 'C'))
+        return false;
+    header.kind = getLE(src + 2, 2);
+    header.length = getLE(src + 4, 4);
+    header.time = (int64_t)getLE(src + 8, 8);
+    return (header.kind >= recordFileHeader) && (header.kind <= recordEnd);
+}
+
+bool gpsContainer::isContainer(const uint8_t *data, size_t length)
+{
+    gpsRecordHeader header;
+    return (length >= recordHeaderSize) && getRecordHeader(data, header) &&
+            (header.kind == recordFileHeader);
+}
+
+bool gpsContainer::getFileHeader(const uint8_t *payload, size_t length, gpsContainerFileHeader &header)
+{
+    // version (2), protocol version (1), reserved (5), device name (56)
+    if(length < fileHeaderSize)
+        return false;
+    header.formatVersion = getLE(payload, 2);
+    header.protoVers = payload[2];
+    const char *name = (const char*)payload + 8;
+    header.device = std::string(name, strnlen(name, deviceNameSize));
+    return true;
+}
+
+bool gpsContainer::getIndexRecord(const uint8_t *payload, size_t length, uint64_t *previous,
+                                  std::vector<gpsIndexEntry> &entries)
+{
+    if(length < indexHeaderSize)
+        return false;
+    uint32_t count = getLE(payload, 4);
+    if(length < indexHeaderSize + (size_t)count * indexEntrySize)
+        return false;
+    *previous = getLE(payload + 8, 8);
+    const uint8_t *p = payload + indexHeaderSize;
+    for(uint32_t i=0; i < count; i++)
+    {
+        gpsIndexEntry e;
+        e.offset = getLE(p, 8);
+        e.counter = getLE(p + 8, 4);
+        e.validityTime = getLE(p + 12, 4);
+        entries.push_back(e);
+        p += indexEntrySize;
+    }
+    return true;
+}
+
+bool gpsContainer::getEndRecord(const uint8_t *payload, size_t length, uint64_t *lastIndex, uint64_t *covered)
+{
+    if(length < endSize)
+        return false;
+    *lastIndex = getLE(payload, 8);
+    *covered = getLE(payload + 8, 8);
+    return true;
+}
+
+int64_t gpsContainer::timeNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Writer:
+
+void gpsContainerWriter::setDevice(const std::string &device)
+{
+    this->device = device;
+}
+
+void gpsContainerWriter::reset(uint64_t lastIndex)
+{
+    haveHeader = false;
+    telegramsSinceEntry = 0;
+    entries.clear();
+    this->lastIndex = lastIndex;
+}
+
+void gpsContainerWriter::begin(uint64_t fileOffset)
+{
+    offset = fileOffset;
+    scratch.clear();
+    pieces.clear();
+}
+
+uint8_t *gpsContainerWriter::addScratch(size_t length)
+{
+    piece p;
+    p.data = NULL;
+    p.scratchOffset = scratch.size();
+    p.length = length;
+    pieces.push_back(p);
+    scratch.resize(scratch.size() + length);
+    offset += length;
+    return &scratch[p.scratchOffset];
+}
+
+void gpsContainerWriter::addFileHeader(uint8_t protoVers)
+{
+    uint8_t *r = addScratch(gpsContainer::recordHeaderSize + gpsContainer::fileHeaderSize);
+    gpsContainer::putRecordHeader(r, recordFileHeader, gpsContainer::fileHeaderSize, gpsContainer::timeNow());
+    uint8_t *payload = r + gpsContainer::recordHeaderSize;
+    memset(payload, 0, gpsContainer::fileHeaderSize);
+    putLE(payload, gpsContainer::formatVersion, 2);
+    payload[2] = protoVers;
+    memcpy(payload + 8, device.data(), std::min(device.size(), gpsContainer::deviceNameSize));
+    haveHeader = true;
+}
+
+void gpsContainerWriter::addTelegram(const gpsTelegramView &telegram, int64_t receiveTime)
+{
+    if(!haveHeader)
+        addFileHeader(telegram.length() > 2 ? telegram.data()[2] : 0);
+
+    // Note the first telegram, and every indexInterval after:
+    if(telegramsSinceEntry == 0)
+    {
+        gpsMessage m;
+        const decodePlan *plan = NULL;
+        if(gpsBinaryReader::decodeHeader(telegram.data(), telegram.length(), m, &plan) == decodeOK)
+        {
+            // Added to the index record after the telegram, below.
+            gpsIndexEntry e;
+            e.offset = offset;
+            e.counter = m.counter;
+            e.validityTime = m.navDataValidityTime;
+            entries.push_back(e);
+        }
+    }
+    if(++telegramsSinceEntry == indexInterval)
+        telegramsSinceEntry = 0;
+
+    uint8_t *r = addScratch(gpsContainer::recordHeaderSize);
+    gpsContainer::putRecordHeader(r, recordTelegram, telegram.length(), receiveTime);
+    piece p;
+    p.data = telegram.data();
+    p.scratchOffset = 0;
+    p.length = telegram.length();
+    pieces.push_back(p);
+    offset += telegram.length();
+
+    if(entries.size() == indexBlockEntries)
+        addIndexRecord();
+}
+
+void gpsContainerWriter::addIndexEntry(uint64_t offset, uint32_t counter, uint32_t validityTime)
+{
+    gpsIndexEntry e;
+    e.offset = offset;
+    e.counter = counter;
+    e.validityTime = validityTime;
+    entries.push_back(e);
+    if(entries.size() == indexBlockEntries)
+        addIndexRecord();
+}
+
+void gpsContainerWriter::addIndexRecord()
+{
+    size_t length = gpsContainer::indexHeaderSize + entries.size() * gpsContainer::indexEntrySize;
+    uint64_t recordOffset = offset;
+    uint8_t *r = addScratch(gpsContainer::recordHeaderSize + length);
+    gpsContainer::putRecordHeader(r, recordIndex, length, gpsContainer::timeNow());
+    uint8_t *p = r + gpsContainer::recordHeaderSize;
+    putLE(p, entries.size(), 4);
+    putLE(p + 4, 0, 4);
+    putLE(p + 8, lastIndex, 8);
+    p += gpsContainer::indexHeaderSize;
+    for(size_t i=0; i < entries.size(); i++)
+    {
+        putLE(p, entries[i].offset, 8);
+        putLE(p + 8, entries[i].counter, 4);
+        putLE(p + 12, entries[i].validityTime, 4);
+        p += gpsContainer::indexEntrySize;
+    }
+    lastIndex = recordOffset;
+    entries.clear();
+}
+
+void gpsContainerWriter::finish(uint64_t covered)
+{
+    if(!entries.empty())
+        addIndexRecord();
+    uint8_t *r = addScratch(gpsContainer::endRecordSize);
+    gpsContainer::putRecordHeader(r, recordEnd, gpsContainer::endSize, gpsContainer::timeNow());
+    putLE(r + gpsContainer::recordHeaderSize, lastIndex, 8);
+    putLE(r + gpsContainer::recordHeaderSize + 8, covered, 8);
+}
+
+const std::vector<struct iovec> &gpsContainerWriter::iovecs()
+{
+    // Resolved here, as the scratch space may have moved while growing:
+    iov.resize(pieces.size());
+    for(size_t i=0; i < pieces.size(); i++)
+    {
+        const uint8_t *data = pieces[i].data ? pieces[i].data : &scratch[pieces[i].scratchOffset];
+        iov[i].iov_base = (void*)data;
+        iov[i].iov_len = pieces[i].length;
+    }
+    return iov;
+}
+
+bool gpsContainerWriter::started()
+{
+    return haveHeader;
+}
+
+size_t gpsContainerWriter::bytes()
+{
+    size_t total = 0;
+    for(size_t i=0; i < pieces.size(); i++)
+        total += pieces[i].length;
+    return total;
+}
@@ -0,0 +1,130 @@
+#ifndef GPSLOGCONTAINER_H
+#define GPSLOGCONTAINER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "gpsreceivering.h"
+
+// Container format for binary GPS logs, as written by gpsBinaryLogger
+// when asked to instead of raw telegrams. The file is a sequence of
+// records, each with a 16 byte header:
+//
+//   bytes 0-1   "GC"
+//   bytes 2-3   record kind, see gpsRecordKinds
+//   bytes 4-7   payload length
+//   bytes 8-15  time, microseconds since the epoch: when the telegram
+//               was received, or when the record was written
+//
+// A file header record starts each logging session. Every telegram is
+// one record, so files are read record by record, without looking for
+// "IX". Every indexInterval telegrams the writer notes the record
+// offset, counter and validity time, and every indexBlockEntries notes
+// go out as an index record. Each index record points back to the one
+// before it. Closing the file adds an end record pointing at the last
+// index record. A reader can then start from the end of the file and
+// walk the chain, without reading the telegrams.
+//
+// The sidecar index for a raw log ("<log>.idx") is a file in the same
+// format holding only header, index and end records. There the offsets
+// are into the raw log. See gpsLogIndex.
+//
+// Multi-byte fields are little endian, to suit the logging hosts.
+
+enum gpsRecordKinds {
+    recordFileHeader = 1,
+    recordTelegram = 2,
+    recordIndex = 3,
+    recordEnd = 4
+};
+
+struct gpsRecordHeader {
+    uint16_t kind;
+    uint32_t length;
+    int64_t time;
+};
+
+struct gpsIndexEntry {
+    uint64_t offset; // of the record, or of the telegram in a raw log
+    uint32_t counter;
+    uint32_t validityTime; // navDataValidityTime, 100 us since midnight
+};
+
+struct gpsContainerFileHeader {
+    uint16_t formatVersion;
+    uint8_t protoVers; // of the first telegram
+    std::string device; // up to deviceNameSize bytes
+};
+
+namespace gpsContainer {
+    static const size_t recordHeaderSize = 16;
+    static const uint16_t formatVersion = 1;
+    static const size_t fileHeaderSize = 64; // payload
+    static const size_t deviceNameSize = 56;
+    static const size_t indexHeaderSize = 16; // payload, before the entries
+    static const size_t indexEntrySize = 16;
+    static const size_t endSize = 16; // payload
+    static const size_t endRecordSize = recordHeaderSize + endSize;
+    static const uint64_t noOffset = ~(uint64_t)0;
+
+    void putRecordHeader(uint8_t *dst, uint16_t kind, uint32_t length, int64_t time);
+    bool getRecordHeader(const uint8_t *src, gpsRecordHeader &header);
+    bool isContainer(const uint8_t *data, size_t length); // starts with a file header record
+    bool getFileHeader(const uint8_t *payload, size_t length, gpsContainerFileHeader &header);
+
+    // Index record payload: entry count, reserved, previous index record
+    // offset, then the entries.
+    bool getIndexRecord(const uint8_t *payload, size_t length, uint64_t *previous,
+                        std::vector<gpsIndexEntry> &entries);
+    // End record payload: last index record offset, bytes covered.
+    bool getEndRecord(const uint8_t *payload, size_t length, uint64_t *lastIndex, uint64_t *covered);
+
+    int64_t timeNow(); // microseconds since the epoch
+}
+
+// Turns telegrams into container records, keeping the sparse index as
+// it goes. For each write, call begin() with the file offset, add the
+// records, and write out iovecs(), which stay valid until the next begin().
+class gpsContainerWriter
+{
+    std::vector<uint8_t> scratch; // record headers, index and end records
+    struct piece {
+        const uint8_t *data; // NULL for scratch
+        size_t scratchOffset;
+        size_t length;
+    };
+    std::vector<piece> pieces;
+    std::vector<struct iovec> iov;
+    uint64_t offset = 0; // in the file, of the next record
+
+    std::string device;
+    bool haveHeader = false;
+    uint64_t telegramsSinceEntry = 0;
+    std::vector<gpsIndexEntry> entries; // not yet written
+    uint64_t lastIndex = gpsContainer::noOffset;
+
+    uint8_t *addScratch(size_t length);
+    void addIndexRecord();
+
+public:
+    static const size_t indexInterval = 200; // telegrams, about a second
+    static const size_t indexBlockEntries = 64;
+
+    void setDevice(const std::string &device);
+    void reset(uint64_t lastIndex = gpsContainer::noOffset); // for a new file, or the last index record of one being added to
+
+    void begin(uint64_t fileOffset);
+    void addFileHeader(uint8_t protoVers);
+    void addTelegram(const gpsTelegramView &telegram, int64_t receiveTime);
+    void addIndexEntry(uint64_t offset, uint32_t counter, uint32_t validityTime); // for sidecars
+    void finish(uint64_t covered); // index records still due, and the end record
+    const std::vector<struct iovec> &iovecs();
+    size_t bytes(); // in iovecs()
+    bool started(); // a file header has been added since reset()
+};
+
+#endif // GPSLOGCONTAINER_H
@@ -0,0 +1,578 @@
+#include "gpslogconverter.h"
+#include "gpsblocklayout.h"
+#include "gpslogcontainer.h"
+#include "gpslogindex.h"
+#include "gpslogseeker.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include <QElapsedTimer>
+
+static size_t fileElementSize(unsigned char kind)
+{
+    // Size of a value of the kind in a columnar file:
+    switch(kind)
+    {
+    case fieldByte:
+    case fieldQuality:
+        return 1;
+    case fieldWord:
+        return 2;
+    case fieldDouble:
+        return 8;
+    default:
+        return 4;
+    }
+}
+
+static void appendLE(std::string &out, uint64_t value, size_t bytes)
+{
+    for(size_t i=0; i < bytes; i++)
+    {
+        out.push_back((char)(value & 0xff));
+        value >>= 8;
+    }
+}
+
+gpsLogConverter::gpsLogConverter()
+    : fullBlocks(queueDepth), freeBlocks(queueDepth), fullChunks(queueDepth), freeChunks(queueDepth)
+{
+    finished = false;
+    error = 0;
+}
+
+bool gpsLogConverter::addField(const std::string &name)
+{
+    uint16_t memberOffset;
+    if(!gpsColumnStore::findField(name, &memberOffset))
+        return false;
+    fields.push_back(memberOffset);
+    fieldNames.push_back(name);
+    return true;
+}
+
+void gpsLogConverter::setFormat(outputFormats format)
+{
+    this->format = format;
+}
+
+void gpsLogConverter::setTimeRange(int64_t from, int64_t to)
+{
+    timeFrom = from;
+    timeTo = to;
+}
+
+void gpsLogConverter::setDecimation(uint32_t keepEvery)
+{
+    decimation = keepEvery ? keepEvery : 1;
+}
+
+int gpsLogConverter::run(const std::string &inputPath, const std::string &outputPath)
+{
+    bytesRead = 0;
+    telegrams = 0;
+    decodeErrors = 0;
+    rowsWritten = 0;
+    bytesWritten = 0;
+    rowsInRange = 0;
+    seconds = 0;
+    readSeconds = 0;
+    decodeSeconds = 0;
+    formatSeconds = 0;
+    finished = false;
+    error = 0;
+
+    int err = startAt(inputPath);
+    if(err != 0)
+        return err;
+    output = (outputPath == "-") ? stdout : fopen(outputPath.c_str(), "wb");
+    if(output == NULL)
+    {
+        err = errno;
+        fclose(input);
+        input = NULL;
+        return err;
+    }
+
+    // Everything that will be in flight:
+    block *b;
+    chunk *c;
+    while(fullBlocks.pop(b) || freeBlocks.pop(b))
+        ;
+    while(fullChunks.pop(c) || freeChunks.pop(c))
+        ;
+    blocks.clear();
+    chunks.clear();
+    for(size_t i=0; i < queueDepth; i++)
+    {
+        blocks.push_back(std::unique_ptr<block>(new block));
+        blocks.back()->data.resize(blockSize);
+        freeBlocks.push(blocks.back().get());
+
+        chunks.push_back(std::unique_ptr<chunk>(new chunk));
+        for(size_t f=0; f < fields.size(); f++)
+            chunks.back()->store.addColumn(fields[f]);
+        chunks.back()->store.reserve(chunkRows);
+        freeChunks.push(chunks.back().get());
+    }
+    framer.reset();
+    carry.clear();
+    current = NULL;
+    text.clear();
+
+    QElapsedTimer timer;
+    timer.start();
+    if(format == formatColumnar)
+        writeHeader();
+    std::thread reader(&gpsLogConverter::readLoop, this);
+    std::thread decoder(&gpsLogConverter::decodeLoop, this);
+    formatLoop();
+    reader.join();
+    decoder.join();
+    seconds = timer.nsecsElapsed() / 1E9;
+
+    fclose(input);
+    input = NULL;
+    if(output == stdout)
+    {
+        fflush(stdout);
+    } else if((fclose(output) != 0) && (error == 0))
+    {
+        error = errno;
+    }
+    output = NULL;
+    return error;
+}
+
+int gpsLogConverter::startAt(const std::string &inputPath)
+{
+    input = fopen(inputPath.c_str(), "rb");
+    if(input == NULL)
+        return errno;
+    uint8_t first[gpsContainer::recordHeaderSize];
+    size_t nread = fread(first, sizeof(char), sizeof(first), input);
+    rewind(input);
+    container = gpsContainer::isContainer(first, nread);
+
+    if((timeFrom < 0) && (timeTo < 0))
+        return 0;
+
+    // Skip what comes before the range without reading it:
+    gpsLogSeeker seeker;
+    int err = seeker.open(inputPath);
+    if(err != 0)
+    {
+        fclose(input);
+        input = NULL;
+        return err;
+    }
+    firstTime = seeker.getFirstTime();
+    if(timeFrom >= 0)
+    {
+        unwrappedFrom = unwrap(timeFrom);
+        fseeko(input, seeker.offsetOfTime(timeFrom), SEEK_SET);
+    }
+    if(timeTo >= 0)
+        unwrappedTo = unwrap(timeTo);
+    return 0;
+}
+
+template<typename T> void gpsLogConverter::pushWait(gpsSpscQueue<T*> &queue, T *item)
+{
+    while(!queue.push(std::move(item)))
+    {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    wake.notify_all();
+}
+
+template<typename T> T *gpsLogConverter::popWait(gpsSpscQueue<T*> &queue)
+{
+    T *item;
+    while(!queue.pop(item))
+    {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    wake.notify_all();
+    return item;
+}
+
+// Read stage:
+
+void gpsLogConverter::readLoop()
+{
+    QElapsedTimer busy;
+    while(true)
+    {
+        block *b = popWait(freeBlocks);
+        busy.start();
+        b->length = finished ? 0 : fread(b->data.data(), sizeof(char), blockSize, input);
+        bytesRead += b->length;
+        b->last = finished || (b->length < blockSize);
+        if(b->last && ferror(input))
+            error = EIO;
+        readSeconds += busy.nsecsElapsed() / 1E9;
+        pushWait(fullBlocks, b);
+        if(b->last)
+            break;
+    }
+}
+
+// Decode stage:
+
+void gpsLogConverter::decodeLoop()
+{
+    QElapsedTimer busy;
+    while(true)
+    {
+        block *b = popWait(fullBlocks);
+        busy.start();
+        // Once past the range, the rest is only handed back:
+        if(!finished && container)
+        {
+            decodeRecords(b->data.data(), b->length);
+        } else if(!finished)
+        {
+            framer.append(b->data.data(), b->length);
+            const uint8_t *telegram;
+            size_t length;
+            uint32_t byteSum;
+            while(framer.next(&telegram, &length, &byteSum))
+                addTelegram(telegram, length, &byteSum);
+        }
+        bool last = b->last;
+        decodeSeconds += busy.nsecsElapsed() / 1E9;
+        pushWait(freeBlocks, b);
+        if(last)
+            break;
+    }
+    sendChunk(true);
+}
+
+void gpsLogConverter::decodeRecords(const uint8_t *data, size_t length)
+{
+    // As the replay reader does, a record at a time. A record cut off by
+    // the end of the block waits in carry for the next one.
+    carry.insert(carry.end(), data, data + length);
+    size_t pos = 0;
+    while(pos + gpsContainer::recordHeaderSize <= carry.size())
+    {
+        gpsRecordHeader h;
+        if(!gpsContainer::getRecordHeader(carry.data() + pos, h))
+        {
+            pos++; // damaged, look for the next record one byte on
+            continue;
+        }
+        size_t payload = pos + gpsContainer::recordHeaderSize;
+        if(payload + h.length > carry.size())
+            break;
+        pos = payload + h.length;
+        const uint8_t *telegram;
+        size_t telegramLength;
+        uint32_t byteSum;
+        size_t at = 0;
+        if((h.kind == recordTelegram) &&
+                recordFramer.nextIn(carry.data() + payload, h.length, &at, &telegram, &telegramLength, &byteSum) &&
+                (telegramLength == h.length))
+            addTelegram(telegram, telegramLength, &byteSum);
+    }
+    carry.erase(carry.begin(), carry.begin() + pos);
+}
+
+void gpsLogConverter::addTelegram(const uint8_t *telegram, size_t length, const uint32_t *byteSum)
+{
+    if(current == NULL)
+    {
+        current = popWait(freeChunks);
+        current->store.clear();
+        current->last = false;
+    }
+    telegrams++;
+    if(current->store.append(telegram, length, &cache, byteSum) != decodeOK)
+        decodeErrors++;
+    if(current->store.rowCount() == chunkRows)
+        sendChunk(false);
+}
+
+void gpsLogConverter::sendChunk(bool last)
+{
+    if(current == NULL)
+    {
+        current = popWait(freeChunks);
+        current->store.clear();
+    }
+    current->last = last;
+    pushWait(fullChunks, current);
+    current = NULL;
+}
+
+// Format stage:
+
+void gpsLogConverter::formatLoop()
+{
+    QElapsedTimer busy;
+    while(true)
+    {
+        chunk *c = popWait(fullChunks);
+        busy.start();
+        if(!finished)
+        {
+            selectRows(c->store);
+            if(format == formatColumnar)
+                writeColumns(c->store);
+            else
+                writeCSV(c->store);
+        }
+        bool last = c->last;
+        formatSeconds += busy.nsecsElapsed() / 1E9;
+        pushWait(freeChunks, c);
+        if(last)
+            break;
+    }
+    if((format == formatColumnar) && (error == 0))
+        appendLE(text, 0, 4); // end of the chunks
+    flushText(true);
+}
+
+uint64_t gpsLogConverter::unwrap(uint32_t validityTime)
+{
+    // Validity times start again at midnight:
+    if(validityTime + gpsLogIndex::dayLength/2 < firstTime)
+        return (uint64_t)validityTime + gpsLogIndex::dayLength;
+    return validityTime;
+}
+
+void gpsLogConverter::selectRows(gpsColumnStore &store)
+{
+    selected.clear();
+    const dword *times = store.validityTimes();
+    for(size_t row=0; row < store.rowCount(); row++)
+    {
+        if((timeFrom >= 0) || (timeTo >= 0))
+        {
+            uint64_t t = unwrap(times[row]);
+            if((timeFrom >= 0) && (t < unwrappedFrom))
+                continue;
+            if((timeTo >= 0) && (t > unwrappedTo))
+            {
+                finished = true; // times only go up through a log
+                break;
+            }
+        }
+        if((rowsInRange++ % decimation) == 0)
+            selected.push_back(row);
+    }
+    rowsWritten += selected.size();
+}
+
+void gpsLogConverter::writeHeader()
+{
+    text.append("GPSCOLS1", 8);
+    appendLE(text, fields.size(), 4);
+    for(size_t f=0; f < fields.size(); f++)
+    {
+        unsigned char kind = chunks[0]->store.kind(fields[f]);
+        text.push_back((char)kind);
+        text.push_back((char)fileElementSize(kind));
+        appendLE(text, fieldNames[f].size(), 2);
+        text.append(fieldNames[f]);
+    }
+}
+
+void gpsLogConverter::writeCSV(gpsColumnStore &store)
+{
+    if(bytesWritten + text.size() == 0)
+    {
+        text.append("counter,navDataValidityTime");
+        for(size_t f=0; f < fieldNames.size(); f++)
+            text.append(",").append(fieldNames[f]);
+        text.append("\n");
+    }
+
+    // Looked up once a chunk rather than for every value:
+    size_t fieldCount = fields.size();
+    std::vector<const uint8_t*> columns(fieldCount);
+    std::vector<const uint64_t*> presence(fieldCount);
+    std::vector<size_t> sizes(fieldCount);
+    std::vector<unsigned char> kinds(fieldCount);
+    for(size_t f=0; f < fieldCount; f++)
+    {
+        columns[f] = (const uint8_t*)store.column(fields[f]);
+        presence[f] = store.validity(fields[f]);
+        sizes[f] = store.elementSize(fields[f]);
+        kinds[f] = store.kind(fields[f]);
+    }
+
+    const dword *counters = store.counters();
+    const dword *times = store.validityTimes();
+    for(size_t i=0; i < selected.size(); i++)
+    {
+        uint32_t row = selected[i];
+        appendUnsigned(counters[row]);
+        text.push_back(',');
+        appendUnsigned(times[row]);
+        for(size_t f=0; f < fieldCount; f++)
+        {
+            text.push_back(',');
+            if(presence[f][row / 64] & (1ULL << (row % 64)))
+                appendValue(kinds[f], columns[f] + row*sizes[f]);
+        }
+        text.push_back('\n');
+        flushText(false);
+    }
+}
+
+void gpsLogConverter::appendUnsigned(uint32_t value)
+{
+    // Faster than snprintf(), which the integers would mostly be:
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while(value);
+    while(n)
+        text.push_back(digits[--n]);
+}
+
+void gpsLogConverter::appendValue(unsigned char kind, const uint8_t *value)
+{
+    char number[32];
+    int n = 0;
+    switch(kind)
+    {
+    case fieldByte:
+        appendUnsigned(*(const unsigned char*)value);
+        break;
+    case fieldWord:
+        appendUnsigned(*(const word*)value);
+        break;
+    case fieldDWord:
+        appendUnsigned(*(const dword*)value);
+        break;
+    case fieldLong:
+        if(*(const long*)value < 0)
+            text.push_back('-');
+        appendUnsigned((*(const long*)value < 0) ? 0U - (uint32_t)*(const long*)value : (uint32_t)*(const long*)value);
+        break;
+    case fieldFloat:
+        n = snprintf(number, sizeof(number), "%.9g", *(const float*)value);
+        break;
+    case fieldDouble:
+        n = snprintf(number, sizeof(number), "%.15g", *(const double*)value);
+        break;
+    case fieldQuality:
+        appendUnsigned(*(const gpsQualityKinds*)value);
+        break;
+    default:
+        break;
+    }
+    text.append(number, n);
+}
+
+void gpsLogConverter::writeColumns(gpsColumnStore &store)
+{
+    size_t rows = selected.size();
+    if(rows == 0)
+        return; // a chunk of no rows would end the file
+    appendLE(text, rows, 4);
+    const dword *counters = store.counters();
+    const dword *times = store.validityTimes();
+    for(size_t i=0; i < rows; i++)
+        appendLE(text, counters[selected[i]], 4);
+    for(size_t i=0; i < rows; i++)
+        appendLE(text, times[selected[i]], 4);
+
+    for(size_t f=0; f < fields.size(); f++)
+    {
+        unsigned char kind = store.kind(fields[f]);
+        size_t size = fileElementSize(kind);
+        size_t elementSize = store.elementSize(fields[f]);
+        const uint8_t *column = (const uint8_t*)store.column(fields[f]);
+        for(size_t i=0; i < rows; i++)
+        {
+            const uint8_t *value = column + selected[i]*elementSize;
+            uint64_t bits = 0;
+            if(kind == fieldLong)
+                bits = (uint32_t)(int32_t)*(const long*)value;
+            else if(kind == fieldQuality)
+                bits = (uint8_t)*(const gpsQualityKinds*)value;
+            else
+                memcpy(&bits, value, size); // little endian host
+            appendLE(text, bits, size);
+        }
+        size_t presenceAt = text.size();
+        text.append((rows + 7) / 8, '\0');
+        for(size_t i=0; i < rows; i++)
+        {
+            if(store.isValid(fields[f], selected[i]))
+                text[presenceAt + i/8] |= (char)(1 << (i % 8));
+        }
+    }
+    flushText(false);
+}
+
+void gpsLogConverter::flushText(bool force)
+{
+    if(text.empty() || (!force && (text.size() < blockSize)))
+        return;
+    size_t written = fwrite(text.data(), sizeof(char), text.size(), output);
+    bytesWritten += written;
+    if((written != text.size()) && (error == 0))
+    {
+        error = errno ? errno : EIO;
+        finished = true;
+    }
+    text.clear();
+}
+
+uint64_t gpsLogConverter::getBytesRead()
+{
+    return bytesRead;
+}
+
+uint64_t gpsLogConverter::getTelegrams()
+{
+    return telegrams;
+}
+
+uint64_t gpsLogConverter::getDecodeErrors()
+{
+    return decodeErrors;
+}
+
+uint64_t gpsLogConverter::getRowsWritten()
+{
+    return rowsWritten;
+}
+
+uint64_t gpsLogConverter::getBytesWritten()
+{
+    return bytesWritten;
+}
+
+double gpsLogConverter::getSeconds()
+{
+    return seconds;
+}
+
+double gpsLogConverter::getReadSeconds()
+{
+    return readSeconds;
+}
+
+double gpsLogConverter::getDecodeSeconds()
+{
+    return decodeSeconds;
+}
+
+double gpsLogConverter::getFormatSeconds()
+{
+    return formatSeconds;
+}
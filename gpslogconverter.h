@@ -0,0 +1,154 @@
+#ifndef GPSLOGCONVERTER_H
+#define GPSLOGCONVERTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gpscolumnstore.h"
+#include "gpsspscqueue.h"
+#include "gpstelegramframer.h"
+
+// Converts a binary log, raw or container, to CSV or to a columnar
+// file. Three threads run as a pipeline:
+//
+//   read    the file, blockSize bytes at a time
+//   decode  the telegrams, into gpsColumnStore chunks of the chosen fields
+//   format  the rows in the time range, decimated, to the output
+//
+// Blocks and chunks go along bounded queues and come back empty to be
+// used again, so a few of each are all that is ever held, whatever the
+// size of the log. A slow stage holds up the ones before it.
+//
+// A time range starts with gpsLogSeeker, so the telegrams before it are
+// not read, and reading stops once past its end. Times are
+// navDataValidityTime, 100 us since midnight UTC; times before the first
+// telegram of the log are taken to be on the day after.
+//
+// CSV has a header line of the column names. Fields from blocks absent
+// from a telegram are left empty.
+//
+// Columnar files are little endian:
+//   "GPSCOLS1", uint32 field count, and for each field: uint8 kind
+//   (blockFieldKinds), uint8 element size, uint16 name length, name.
+//   Then chunks: uint32 row count, counter[rows] and
+//   navDataValidityTime[rows] as uint32, and for each field
+//   values[rows] then a presence bitmap of (rows + 7) / 8 bytes, bit
+//   (row % 8) of byte (row / 8). A chunk of 0 rows ends the file.
+//   Long fields are written as int32, quality fields as uint8.
+class gpsLogConverter
+{
+public:
+    enum outputFormats {
+        formatCSV,
+        formatColumnar
+    };
+
+    static const size_t blockSize = 1 << 20;
+    static const size_t chunkRows = 8192;
+    static const size_t queueDepth = 4; // blocks or chunks per queue
+
+    gpsLogConverter();
+
+    bool addField(const std::string &name); // false if there is no such field
+    void setFormat(outputFormats format);
+    void setTimeRange(int64_t from, int64_t to); // navDataValidityTime, -1 for no limit
+    void setDecimation(uint32_t keepEvery); // of the telegrams in range; 1 keeps all
+
+    // Returns 0, or an errno value. An output path of "-" is stdout.
+    int run(const std::string &inputPath, const std::string &outputPath);
+
+    // For the last run():
+    uint64_t getBytesRead();
+    uint64_t getTelegrams();
+    uint64_t getDecodeErrors();
+    uint64_t getRowsWritten();
+    uint64_t getBytesWritten();
+    double getSeconds();
+    double getReadSeconds(); // time each stage was busy, not waiting on the others
+    double getDecodeSeconds();
+    double getFormatSeconds();
+
+private:
+    struct block {
+        std::vector<uint8_t> data;
+        size_t length = 0;
+        bool last = false;
+    };
+    struct chunk {
+        gpsColumnStore store;
+        bool last = false;
+    };
+
+    std::vector<uint16_t> fields;
+    std::vector<std::string> fieldNames;
+    outputFormats format = formatCSV;
+    int64_t timeFrom = -1;
+    int64_t timeTo = -1;
+    uint32_t decimation = 1;
+
+    FILE *input = NULL;
+    FILE *output = NULL;
+    bool container = false;
+    uint32_t firstTime = 0; // for times after midnight
+    uint64_t unwrappedFrom = 0;
+    uint64_t unwrappedTo = 0;
+
+    std::vector<std::unique_ptr<block>> blocks;
+    std::vector<std::unique_ptr<chunk>> chunks;
+    gpsSpscQueue<block*> fullBlocks;
+    gpsSpscQueue<block*> freeBlocks;
+    gpsSpscQueue<chunk*> fullChunks;
+    gpsSpscQueue<chunk*> freeChunks;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<bool> finished; // past the time range, or a write failed
+    std::atomic<int> error;
+
+    uint64_t bytesRead = 0;
+    uint64_t telegrams = 0;
+    uint64_t decodeErrors = 0;
+    uint64_t rowsWritten = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t rowsInRange = 0;
+    double seconds = 0;
+    double readSeconds = 0;
+    double decodeSeconds = 0;
+    double formatSeconds = 0;
+
+    template<typename T> void pushWait(gpsSpscQueue<T*> &queue, T *item);
+    template<typename T> T *popWait(gpsSpscQueue<T*> &queue);
+
+    int startAt(const std::string &inputPath);
+    void readLoop();
+    void decodeLoop();
+    void formatLoop();
+
+    chunk *current = NULL; // being filled by the decode stage
+    gpsTelegramFramer framer;
+    gpsTelegramFramer recordFramer;
+    std::vector<uint8_t> carry; // container records split between blocks
+    decodePlanCache cache;
+    void decodeRecords(const uint8_t *data, size_t length);
+    void addTelegram(const uint8_t *telegram, size_t length, const uint32_t *byteSum);
+    void sendChunk(bool last);
+
+    std::string text; // output waiting to be written
+    std::vector<uint32_t> selected; // rows of the chunk to write
+    uint64_t unwrap(uint32_t validityTime);
+    void selectRows(gpsColumnStore &store);
+    void writeHeader();
+    void writeCSV(gpsColumnStore &store);
+    void writeColumns(gpsColumnStore &store);
+    void appendUnsigned(uint32_t value);
+    void appendValue(unsigned char kind, const uint8_t *value);
+    void flushText(bool force);
+};
+
+#endif // GPSLOGCONVERTER_H
@@ -0,0 +1,188 @@
+#include "gpslogfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <vector>
+
+gpsLogFile::~gpsLogFile()
+{
+    if(isOpen())
+        close();
+}
+
+int gpsLogFile::open(const std::string &path, bool useUring, bool directIO, uint64_t preallocateBytes)
+{
+    if(isOpen())
+        return EBUSY;
+    this->path = path;
+    startOffset = 0;
+    length = 0;
+    preallocated = false;
+
+    uringError = 0;
+    if(useUring)
+    {
+        uringError = uring.open(path.c_str(), directIO);
+        if(uringError == 0)
+        {
+            startOffset = uring.getOffset();
+            if(preallocateBytes > 0)
+                uring.preallocateAhead(preallocateBytes);
+            return 0;
+        }
+    }
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        fd = -1;
+        return errno;
+    }
+    struct stat st;
+    if(fstat(fd, &st) == 0)
+        startOffset = st.st_size;
+#ifdef __linux__
+    // FALLOC_FL_KEEP_SIZE, so that the file only grows as it is written:
+    if((preallocateBytes > 0) && (fallocate(fd, FALLOC_FL_KEEP_SIZE, startOffset, preallocateBytes) == 0))
+        preallocated = true;
+#else
+    (void)preallocateBytes;
+#endif
+    return 0;
+}
+
+int gpsLogFile::append(const struct iovec *iov, size_t count)
+{
+    if(uring.isOpen())
+    {
+        int err = 0;
+        for(size_t i=0; (i < count) && (err == 0); i++)
+        {
+            err = uring.append((const uint8_t*)iov[i].iov_base, iov[i].iov_len);
+            if(err == 0)
+                length += iov[i].iov_len;
+        }
+        if(err == 0)
+            err = uring.flush();
+        return err;
+    }
+    if(fd < 0)
+        return EBADF;
+    // The whole batch in as few system calls as possible:
+    std::vector<struct iovec> remaining(iov, iov + count);
+    return appendDescriptor(remaining.data(), count);
+}
+
+int gpsLogFile::appendDescriptor(struct iovec *iov, size_t count)
+{
+    // iov is used up as it is written.
+    size_t first = 0;
+    while(first < count)
+    {
+        int n = (int)std::min(count - first, (size_t)IOV_MAX);
+        ssize_t written = writev(fd, &iov[first], n);
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return errno;
+        }
+        length += written;
+        // Step over what was written, which may end part way through a telegram:
+        while((first < count) && ((size_t)written >= iov[first].iov_len))
+        {
+            written -= iov[first].iov_len;
+            first++;
+        }
+        if(written > 0)
+        {
+            iov[first].iov_base = (char*)iov[first].iov_base + written;
+            iov[first].iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+int gpsLogFile::close()
+{
+    if(uring.isOpen())
+        return uring.close();
+    if(fd < 0)
+        return EBADF;
+    int err = 0;
+    if(preallocated)
+    {
+        // Give back the space that was not used:
+        struct stat st;
+        if((fstat(fd, &st) != 0) || (ftruncate(fd, st.st_size) != 0))
+            err = errno;
+    }
+    if((::close(fd) != 0) && (err == 0))
+        err = errno;
+    fd = -1;
+    return err;
+}
+
+int gpsLogFile::rename(const std::string &newPath)
+{
+    // Open descriptors follow the file, so this can be done at any time.
+    if(::rename(path.c_str(), newPath.c_str()) != 0)
+        return errno;
+    path = newPath;
+    return 0;
+}
+
+int gpsLogFile::remove()
+{
+    int err = isOpen() ? close() : 0;
+    if(::unlink(path.c_str()) != 0)
+        err = errno;
+    return err;
+}
+
+bool gpsLogFile::isOpen()
+{
+    return uring.isOpen() || (fd >= 0);
+}
+
+bool gpsLogFile::usesUring()
+{
+    return uring.isOpen();
+}
+
+bool gpsLogFile::isDirect()
+{
+    return uring.isOpen() && uring.isDirect();
+}
+
+const std::string &gpsLogFile::getPath()
+{
+    return path;
+}
+
+uint64_t gpsLogFile::getLength()
+{
+    return length;
+}
+
+uint64_t gpsLogFile::getOffset()
+{
+    return startOffset + length;
+}
+
+int gpsLogFile::getUringError()
+{
+    return uringError;
+}
+
+gpsUringWriter &gpsLogFile::uringWriter()
+{
+    return uring;
+}
@@ -0,0 +1,51 @@
+#ifndef GPSLOGFILE_H
+#define GPSLOGFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include <sys/uio.h>
+
+#include "gpsuringwriter.h"
+
+// One log file as written by the gpsBinaryLogger writer thread: through
+// gpsUringWriter when asked for and available, otherwise a plain file
+// descriptor in append mode, written with writev().
+//
+// Space can be preallocated when the file is opened. Whatever is left
+// unused is given back in close().
+class gpsLogFile
+{
+    gpsUringWriter uring;
+    int fd = -1; // when not using io_uring
+    bool preallocated = false;
+    std::string path;
+    uint64_t startOffset = 0; // file size at open()
+    uint64_t length = 0; // bytes appended since open()
+    int uringError = 0;
+
+    int appendDescriptor(struct iovec *iov, size_t count);
+
+public:
+    ~gpsLogFile();
+
+    // Returns 0, or an errno value. If io_uring was asked for but would
+    // not open, the file is opened without it; see getUringError().
+    int open(const std::string &path, bool useUring, bool directIO, uint64_t preallocateBytes);
+    int append(const struct iovec *iov, size_t count);
+    int close();
+    int rename(const std::string &newPath);
+    int remove(); // closes and deletes the file
+
+    bool isOpen();
+    bool usesUring();
+    bool isDirect();
+    const std::string &getPath();
+    uint64_t getLength();
+    uint64_t getOffset(); // where the next append goes
+    int getUringError();
+    gpsUringWriter &uringWriter();
+};
+
+#endif // GPSLOGFILE_H
@@ -0,0 +1,341 @@
+#include "gpslogindex.h"
+#include "gpsbinaryreader.h"
+#include "gpslogfile.h"
+#include "gpstelegramframer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Buffered reads at any offset, for stepping through records:
+class chunkReader
+{
+    int fd;
+    uint64_t fileSize;
+    std::vector<uint8_t> buffer;
+    uint64_t start = 0;
+    size_t filled = 0;
+
+public:
+    static const size_t chunkSize = 1 << 20;
+
+    chunkReader(int fd, uint64_t fileSize) : fd(fd), fileSize(fileSize), buffer(chunkSize) {}
+
+    // n bytes at offset, or NULL if the file ends first:
+    const uint8_t *at(uint64_t offset, size_t n)
+    {
+        if((offset >= start) && (offset + n <= start + filled))
+            return &buffer[offset - start];
+        if(offset + n > fileSize)
+            return NULL;
+        if(n > buffer.size())
+            buffer.resize(n);
+        ssize_t got = pread(fd, buffer.data(), buffer.size(), offset);
+        if(got < (ssize_t)n)
+            return NULL;
+        start = offset;
+        filled = got;
+        return buffer.data();
+    }
+};
+
+static bool decodeEntry(const uint8_t *telegram, size_t length, uint64_t offset, gpsIndexEntry &e)
+{
+    gpsMessage m;
+    const decodePlan *plan = NULL;
+    if(gpsBinaryReader::decodeHeader(telegram, length, m, &plan) != decodeOK)
+        return false;
+    e.offset = offset;
+    e.counter = m.counter;
+    e.validityTime = m.navDataValidityTime;
+    return true;
+}
+
+int gpsLogIndex::load(const std::string &path)
+{
+    entries.clear();
+    container = false;
+    covered = 0;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return errno;
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        int err = errno;
+        ::close(fd);
+        return err;
+    }
+    fileSize = st.st_size;
+
+    uint8_t first[gpsContainer::recordHeaderSize + gpsContainer::fileHeaderSize];
+    ssize_t got = pread(fd, first, sizeof(first), 0);
+    int err;
+    if((got == (ssize_t)sizeof(first)) && gpsContainer::isContainer(first, got))
+    {
+        container = true;
+        gpsContainer::getFileHeader(first + gpsContainer::recordHeaderSize, gpsContainer::fileHeaderSize, header);
+        err = loadContainer(fd);
+        ::close(fd);
+    } else {
+        ::close(fd);
+        err = loadSidecar(sidecarPath(path));
+    }
+    return err;
+}
+
+int gpsLogIndex::loadContainer(int fd)
+{
+    // A file that was closed properly ends with an end record:
+    uint8_t end[gpsContainer::endRecordSize];
+    gpsRecordHeader h;
+    uint64_t lastIndex = gpsContainer::noOffset;
+    if((fileSize < gpsContainer::endRecordSize) ||
+            (pread(fd, end, sizeof(end), fileSize - sizeof(end)) != (ssize_t)sizeof(end)) ||
+            !gpsContainer::getRecordHeader(end, h) || (h.kind != recordEnd) ||
+            !gpsContainer::getEndRecord(end + gpsContainer::recordHeaderSize, h.length, &lastIndex, &covered))
+        return scanContainer(fd, 0);
+
+    // Walk back along the index records:
+    std::vector<std::vector<gpsIndexEntry> > blocks;
+    uint64_t at = lastIndex;
+    std::vector<uint8_t> payload;
+    while(at != gpsContainer::noOffset)
+    {
+        uint8_t rh[gpsContainer::recordHeaderSize];
+        if((at >= fileSize) || (pread(fd, rh, sizeof(rh), at) != (ssize_t)sizeof(rh)) ||
+                !gpsContainer::getRecordHeader(rh, h) || (h.kind != recordIndex))
+            return scanContainer(fd, 0); // not what it says, do it the slow way
+        payload.resize(h.length);
+        if(pread(fd, payload.data(), h.length, at + sizeof(rh)) != (ssize_t)h.length)
+            return scanContainer(fd, 0);
+        blocks.push_back(std::vector<gpsIndexEntry>());
+        uint64_t previous = gpsContainer::noOffset;
+        if(!gpsContainer::getIndexRecord(payload.data(), h.length, &previous, blocks.back()) ||
+                ((previous != gpsContainer::noOffset) && (previous >= at)))
+            return scanContainer(fd, 0);
+        at = previous;
+    }
+    for(size_t i=blocks.size(); i > 0; i--)
+        entries.insert(entries.end(), blocks[i-1].begin(), blocks[i-1].end());
+    return 0;
+}
+
+int gpsLogIndex::scanContainer(int fd, uint64_t from)
+{
+    // Record by record, for a log that was not closed properly. The index
+    // records found are used as they are, and telegrams after the last one
+    // are indexed here.
+    entries.clear();
+    chunkReader r(fd, fileSize);
+    std::vector<gpsIndexEntry> pending;
+    size_t sinceEntry = 0;
+    uint64_t at = from;
+    gpsRecordHeader h;
+    const uint8_t *p;
+    while((p = r.at(at, gpsContainer::recordHeaderSize)) != NULL)
+    {
+        if(!gpsContainer::getRecordHeader(p, h))
+        {
+            at++; // damaged, look for the next record
+            continue;
+        }
+        const uint8_t *payload = r.at(at + gpsContainer::recordHeaderSize, h.length);
+        if(payload == NULL)
+            break; // cut short
+        if(h.kind == recordIndex)
+        {
+            uint64_t previous;
+            if(gpsContainer::getIndexRecord(payload, h.length, &previous, entries))
+                pending.clear();
+        } else if(h.kind == recordFileHeader) {
+            sinceEntry = 0;
+        } else if(h.kind == recordTelegram) {
+            gpsIndexEntry e;
+            if((sinceEntry == 0) && decodeEntry(payload, h.length, at, e))
+                pending.push_back(e);
+            if(++sinceEntry == gpsContainerWriter::indexInterval)
+                sinceEntry = 0;
+        }
+        at += gpsContainer::recordHeaderSize + h.length;
+        covered = at;
+    }
+    entries.insert(entries.end(), pending.begin(), pending.end());
+    return 0;
+}
+
+int gpsLogIndex::loadSidecar(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return errno;
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        int err = errno;
+        ::close(fd);
+        return err;
+    }
+    // Small, and may have been added to, so read all of it:
+    std::vector<uint8_t> data(st.st_size);
+    ssize_t got = pread(fd, data.data(), data.size(), 0);
+    ::close(fd);
+    if(got != (ssize_t)data.size())
+        return EIO;
+
+    size_t at = 0;
+    gpsRecordHeader h;
+    while((at + gpsContainer::recordHeaderSize <= data.size()) && gpsContainer::getRecordHeader(&data[at], h))
+    {
+        const uint8_t *payload = &data[at + gpsContainer::recordHeaderSize];
+        if(at + gpsContainer::recordHeaderSize + h.length > data.size())
+            break;
+        uint64_t previous, lastIndex;
+        if(h.kind == recordIndex)
+            gpsContainer::getIndexRecord(payload, h.length, &previous, entries);
+        else if(h.kind == recordEnd)
+            gpsContainer::getEndRecord(payload, h.length, &lastIndex, &covered);
+        at += gpsContainer::recordHeaderSize + h.length;
+    }
+    return 0;
+}
+
+uint64_t gpsLogIndex::lastIndexRecord(const std::string &path)
+{
+    uint64_t lastIndex = gpsContainer::noOffset;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return lastIndex;
+    uint8_t end[gpsContainer::endRecordSize];
+    gpsRecordHeader h;
+    uint64_t covered;
+    struct stat st;
+    if((fstat(fd, &st) == 0) && (st.st_size >= (off_t)sizeof(end)) &&
+            (pread(fd, end, sizeof(end), st.st_size - sizeof(end)) == (ssize_t)sizeof(end)) &&
+            gpsContainer::getRecordHeader(end, h) && (h.kind == recordEnd) &&
+            !gpsContainer::getEndRecord(end + gpsContainer::recordHeaderSize, h.length, &lastIndex, &covered))
+        lastIndex = gpsContainer::noOffset;
+    ::close(fd);
+    return lastIndex;
+}
+
+std::string gpsLogIndex::sidecarPath(const std::string &rawPath)
+{
+    return rawPath + ".idx";
+}
+
+int gpsLogIndex::buildSidecar(const std::string &rawPath)
+{
+    std::string idxPath = sidecarPath(rawPath);
+
+    // Carry on from whatever the sidecar already covers:
+    gpsLogIndex existing;
+    uint64_t from = 0;
+    uint64_t lastIndex = gpsContainer::noOffset;
+    bool haveSidecar = (access(idxPath.c_str(), F_OK) == 0);
+    if(haveSidecar)
+    {
+        int err = existing.loadSidecar(idxPath);
+        if(err != 0)
+            return err;
+        from = existing.covered;
+    }
+
+    int fd = ::open(rawPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return errno;
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        int err = errno;
+        ::close(fd);
+        return err;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    gpsLogFile sidecar;
+    int err = sidecar.open(idxPath, false, false, 0);
+    if(err != 0)
+    {
+        ::close(fd);
+        return err;
+    }
+    if(haveSidecar)
+        lastIndex = lastIndexRecord(idxPath); // for the chain
+
+    gpsContainerWriter writer;
+    writer.reset(lastIndex);
+    writer.begin(sidecar.getOffset());
+
+    gpsTelegramFramer framer;
+    std::vector<uint8_t> chunk(chunkReader::chunkSize);
+    uint64_t chunkStart = from;
+    uint64_t coveredTo = from;
+    size_t sinceEntry = 0;
+    bool first = !haveSidecar;
+    while(chunkStart < (uint64_t)st.st_size)
+    {
+        ssize_t got = pread(fd, chunk.data(), chunk.size(), chunkStart);
+        if(got <= 0)
+            break;
+        size_t pos = 0;
+        const uint8_t *telegram;
+        size_t length;
+        uint32_t sum;
+        while(framer.nextIn(chunk.data(), got, &pos, &telegram, &length, &sum))
+        {
+            uint64_t offset = chunkStart + (telegram - chunk.data());
+            if(first)
+            {
+                writer.addFileHeader(telegram[2]);
+                first = false;
+            }
+            gpsIndexEntry e;
+            if((sinceEntry == 0) && decodeEntry(telegram, length, offset, e))
+                writer.addIndexEntry(e.offset, e.counter, e.validityTime);
+            if(++sinceEntry == gpsContainerWriter::indexInterval)
+                sinceEntry = 0;
+            coveredTo = offset + length;
+        }
+        if(pos == 0)
+            break; // the rest is one partial telegram
+        chunkStart += pos;
+    }
+    ::close(fd);
+
+    writer.finish(coveredTo);
+    const std::vector<struct iovec> &iov = writer.iovecs();
+    err = sidecar.append(iov.data(), iov.size());
+    int closeErr = sidecar.close();
+    return (err != 0) ? err : closeErr;
+}
+
+bool gpsLogIndex::isContainer()
+{
+    return container;
+}
+
+const gpsContainerFileHeader &gpsLogIndex::fileHeader()
+{
+    return header;
+}
+
+size_t gpsLogIndex::size()
+{
+    return entries.size();
+}
+
+const gpsIndexEntry &gpsLogIndex::entry(size_t n)
+{
+    return entries[n];
+}
+
+uint64_t gpsLogIndex::getCoveredBytes()
+{
+    return covered;
+}
@@ -0,0 +1,48 @@
+#ifndef GPSLOGINDEX_H
+#define GPSLOGINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "gpslogcontainer.h"
+
+// Sparse index of a binary GPS log: known telegram or record starts,
+// with their counters and times. The entries are loaded from a container
+// log, or from the sidecar index next to a raw log, which
+// "gpsconvert --index" writes. gpsLogSeeker searches them.
+class gpsLogIndex
+{
+    std::vector<gpsIndexEntry> entries; // in file order
+    bool container = false;
+    uint64_t fileSize = 0;
+    uint64_t covered = 0; // bytes of the log the entries cover
+    gpsContainerFileHeader header;
+
+    int loadContainer(int fd);
+    int scanContainer(int fd, uint64_t from);
+    int loadSidecar(const std::string &sidecarPath);
+
+public:
+    static const uint32_t dayLength = 864000000; // in 100 us
+
+    // Returns 0, or an errno value. ENOENT for a raw log with no sidecar.
+    int load(const std::string &path);
+
+    // Writes or extends "<rawPath>.idx". Only the part of the raw log
+    // beyond what the sidecar already covers is read.
+    static int buildSidecar(const std::string &rawPath);
+    static std::string sidecarPath(const std::string &rawPath);
+
+    // From the end record of a container or sidecar, if it ends with one:
+    static uint64_t lastIndexRecord(const std::string &path);
+
+    bool isContainer();
+    const gpsContainerFileHeader &fileHeader(); // containers only
+    size_t size();
+    const gpsIndexEntry &entry(size_t n);
+    uint64_t getCoveredBytes();
+};
+
+#endif // GPSLOGINDEX_H
@@ -0,0 +1,206 @@
+#include "gpslogseeker.h"
+#include "gpsbinaryreader.h"
+#include "gpslogindex.h"
+#include "gpstelegramframer.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+
+static bool entryFromTelegram(const uint8_t *telegram, size_t length, uint64_t offset, gpsIndexEntry &e)
+{
+    gpsMessage m;
+    const decodePlan *plan = NULL;
+    if(gpsBinaryReader::decodeHeader(telegram, length, m, &plan) != decodeOK)
+        return false;
+    e.offset = offset;
+    e.counter = m.counter;
+    e.validityTime = m.navDataValidityTime;
+    return true;
+}
+
+int gpsLogSeeker::open(const std::string &path)
+{
+    close();
+    int err = file.open(path, false);
+    if(err != 0)
+        return err;
+    if(file.data() != NULL)
+        madvise((void*)file.data(), file.size(), MADV_RANDOM); // probes, not a read through
+
+    // Whatever index there is to start from:
+    gpsLogIndex index;
+    index.load(path);
+    container = index.isContainer();
+    for(size_t i=0; i < index.size(); i++)
+        known.push_back(index.entry(i));
+
+    gpsIndexEntry first;
+    uint64_t next;
+    if(telegramAt(0, first, &next))
+    {
+        firstTime = first.validityTime;
+        remember(first);
+    }
+    return 0;
+}
+
+void gpsLogSeeker::close()
+{
+    file.close();
+    known.clear();
+    container = false;
+    probes = 0;
+}
+
+bool gpsLogSeeker::isOpen()
+{
+    return file.isOpen();
+}
+
+const std::string &gpsLogSeeker::getPath()
+{
+    return file.getPath();
+}
+
+uint64_t gpsLogSeeker::size()
+{
+    return file.size();
+}
+
+bool gpsLogSeeker::telegramAt(uint64_t from, gpsIndexEntry &e, uint64_t *next)
+{
+    const uint8_t *data = file.data();
+    uint64_t size = file.size();
+    while(from < size)
+    {
+        probes++;
+        if(container)
+        {
+            gpsRecordHeader h;
+            if((from + gpsContainer::recordHeaderSize > size) || !gpsContainer::getRecordHeader(data + from, h))
+            {
+                from++; // damaged, look for the next record one byte on
+                continue;
+            }
+            uint64_t payload = from + gpsContainer::recordHeaderSize;
+            if(payload + h.length > size)
+                return false;
+            *next = payload + h.length;
+            if((h.kind == recordTelegram) && entryFromTelegram(data + payload, h.length, from, e))
+                return true;
+            from = *next;
+        } else {
+            size_t length = 0;
+            const uint8_t *telegram = gpsTelegramFramer::findTelegram(data + from, size - from, &length);
+            if((telegram == NULL) || (length == 0))
+                return false; // none, or cut short at the end
+            uint64_t at = telegram - data;
+            *next = at + length;
+            if(entryFromTelegram(telegram, length, at, e))
+                return true;
+            from = at + 2;
+        }
+    }
+    return false;
+}
+
+uint64_t gpsLogSeeker::key(const gpsIndexEntry &e, seekKeys by)
+{
+    switch(by)
+    {
+    case keyCounter:
+        return e.counter;
+    case keyTime:
+        // Validity times start again at midnight:
+        if(e.validityTime + gpsLogIndex::dayLength/2 < firstTime)
+            return (uint64_t)e.validityTime + gpsLogIndex::dayLength;
+        return e.validityTime;
+    default:
+        return e.offset;
+    }
+}
+
+void gpsLogSeeker::remember(const gpsIndexEntry &e)
+{
+    std::vector<gpsIndexEntry>::iterator it = std::lower_bound(known.begin(), known.end(), e,
+            [](const gpsIndexEntry &a, const gpsIndexEntry &b) { return a.offset < b.offset; });
+    if((it == known.end()) || (it->offset != e.offset))
+        known.insert(it, e);
+}
+
+uint64_t gpsLogSeeker::find(uint64_t target, seekKeys by)
+{
+    if(known.empty())
+        return file.size();
+
+    // Between the last known telegram at or before the target, and the one after:
+    size_t n = std::upper_bound(known.begin(), known.end(), target,
+            [this, by](uint64_t t, const gpsIndexEntry &e) { return t < key(e, by); }) - known.begin();
+    if(n == 0)
+        return known[0].offset;
+    gpsIndexEntry lo = known[n-1];
+    uint64_t hi = (n < known.size()) ? known[n].offset : file.size();
+
+    gpsIndexEntry e;
+    uint64_t next;
+    if(!container)
+    {
+        while(hi - lo.offset > walkSize)
+        {
+            uint64_t mid = lo.offset + (hi - lo.offset) / 2;
+            if(!telegramAt(mid, e, &next) || (e.offset >= hi))
+            {
+                hi = mid;
+                continue;
+            }
+            remember(e);
+            if(key(e, by) <= target)
+                lo = e;
+            else
+                hi = e.offset;
+        }
+    }
+
+    uint64_t at = lo.offset;
+    while(telegramAt(at, e, &next))
+    {
+        if(key(e, by) >= target)
+            return e.offset;
+        at = next;
+    }
+    return file.size();
+}
+
+uint64_t gpsLogSeeker::offsetOfCounter(uint32_t counter)
+{
+    return find(counter, keyCounter);
+}
+
+uint64_t gpsLogSeeker::offsetOfTime(uint32_t navDataValidityTime)
+{
+    gpsIndexEntry e;
+    e.validityTime = navDataValidityTime;
+    return find(key(e, keyTime), keyTime);
+}
+
+uint64_t gpsLogSeeker::offsetOfFraction(double fraction)
+{
+    fraction = std::min(std::max(fraction, 0.0), 1.0);
+    return find(fraction * file.size(), keyOffset);
+}
+
+uint32_t gpsLogSeeker::getFirstTime()
+{
+    return firstTime;
+}
+
+uint64_t gpsLogSeeker::getProbes()
+{
+    return probes;
+}
+
+size_t gpsLogSeeker::getKnownTelegrams()
+{
+    return known.size();
+}
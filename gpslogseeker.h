@@ -0,0 +1,62 @@
+#ifndef GPSLOGSEEKER_H
+#define GPSLOGSEEKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "gpslogcontainer.h"
+#include "gpsmappedfile.h"
+
+// Finds where to resume a replay: the first telegram at or after a
+// counter, a validity time, or a fraction of the way through the file.
+//
+// Container logs, and raw logs with a sidecar, start from gpsLogIndex.
+// Raw logs are also bisected: a telegram is looked for part way between
+// two known ones and its counter or time compared, as both only go up
+// through a log. Telegrams found this way are kept, so the index builds
+// up as it is used and nearby seeks need fewer probes. The last stretch,
+// walkSize or one container index interval, is read telegram by telegram.
+class gpsLogSeeker
+{
+    enum seekKeys {
+        keyCounter,
+        keyTime,
+        keyOffset
+    };
+
+    gpsMappedFile file;
+    bool container = false;
+    std::vector<gpsIndexEntry> known; // by offset
+    uint32_t firstTime = 0;
+    uint64_t probes = 0;
+
+    // First telegram at or after from, which in a container must be the
+    // start of a record. next is where the one after it may start.
+    bool telegramAt(uint64_t from, gpsIndexEntry &e, uint64_t *next);
+    uint64_t key(const gpsIndexEntry &e, seekKeys by);
+    void remember(const gpsIndexEntry &e);
+    uint64_t find(uint64_t target, seekKeys by);
+
+public:
+    static const uint64_t walkSize = 65536;
+
+    int open(const std::string &path); // returns 0, or an errno value
+    void close();
+    bool isOpen();
+    const std::string &getPath();
+    uint64_t size();
+
+    // Offset to resume reading from, at a telegram, or at its record in
+    // a container. Past the last telegram gives the size of the file.
+    uint64_t offsetOfCounter(uint32_t counter);
+    uint64_t offsetOfTime(uint32_t navDataValidityTime); // 100 us since midnight UTC
+    uint64_t offsetOfFraction(double fraction);
+
+    uint32_t getFirstTime(); // validity time of the first telegram
+    uint64_t getProbes(); // telegrams looked at so far
+    size_t getKnownTelegrams();
+};
+
+#endif // GPSLOGSEEKER_H
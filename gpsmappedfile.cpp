@@ -0,0 +1,79 @@
+#include "gpsmappedfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+gpsMappedFile::~gpsMappedFile()
+{
+    close();
+}
+
+int gpsMappedFile::open(const std::string &path, bool sequential)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return errno;
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        int err = errno;
+        ::close(fd);
+        return err;
+    }
+    if((uint64_t)st.st_size > (uint64_t)SIZE_MAX)
+    {
+        ::close(fd);
+        return EFBIG; // will not fit in the address space
+    }
+    if(st.st_size == 0)
+    {
+        ::close(fd);
+        this->path = path; // open, with nothing to map
+        return 0;
+    }
+
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd); // the mapping keeps the file
+    if(p == MAP_FAILED)
+        return err;
+    mapped = (const uint8_t*)p;
+    mappedSize = st.st_size;
+    this->path = path; // only now, so a failed mapping is not open
+    if(sequential)
+        madvise(p, mappedSize, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void gpsMappedFile::close()
+{
+    if(mapped != NULL)
+        munmap((void*)mapped, mappedSize);
+    mapped = NULL;
+    mappedSize = 0;
+    path.clear();
+}
+
+bool gpsMappedFile::isOpen()
+{
+    return (mapped != NULL) || !path.empty();
+}
+
+const uint8_t *gpsMappedFile::data()
+{
+    return mapped;
+}
+
+uint64_t gpsMappedFile::size()
+{
+    return mappedSize;
+}
+
+const std::string &gpsMappedFile::getPath()
+{
+    return path;
+}
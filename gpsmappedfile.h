@@ -0,0 +1,33 @@
+#ifndef GPSMAPPEDFILE_H
+#define GPSMAPPEDFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// A log file mapped read-only into memory, for walking with pointers
+// instead of reading it in small pieces. Offsets and sizes are 64 bit;
+// the whole file is mapped, so very large logs need a 64 bit build.
+//
+// The pages are only read in as they are touched. With sequential set,
+// the kernel reads ahead further and drops pages behind the reader sooner.
+class gpsMappedFile
+{
+    const uint8_t *mapped = NULL;
+    uint64_t mappedSize = 0;
+    std::string path;
+
+public:
+    ~gpsMappedFile();
+
+    // Returns 0, or an errno value. An empty file opens with data() NULL.
+    int open(const std::string &path, bool sequential = true);
+    void close();
+
+    bool isOpen();
+    const uint8_t *data();
+    uint64_t size();
+    const std::string &getPath();
+};
+
+#endif // GPSMAPPEDFILE_H
@@ -10,6 +10,10 @@ gpsNetwork::gpsNetwork(QObject *parent) : QObject(parent)
     dataIn.setDevice(tcpsocket);
     //dataIn.setVersion(QDataStream::);
 
+    // Keep file writes off the thread reading the socket:
+    binLoggerPrimary.setWriterThreadMode(true);
+    binLoggerSecondary.setWriterThreadMode(true);
+
     binLoggerPrimary.setPrimaryLogStatus(true);
     binLoggerPrimary.setFilename("/tmp/gps_DEFAULTFILENAME_primary.log"); // temporary filename
 
@@ -50,6 +54,9 @@ void gpsNetwork::setGPSHost(QString gpsHost, int gpsPort)
 
 void gpsNetwork::setConnected()
 {
+    // Anything left over from an earlier connection is of no use:
+    framer.reset();
+    ring.reset();
     connectedToHost = true;
     emit connectionGood();
 }
@@ -64,6 +71,8 @@ void gpsNetwork::connectToGPS(QString gpsHost, int gpsPort, QString gpsBinaryLog
 {
     // Public slot to start connection
 
+    binLoggerPrimary.setDeviceName(QString("%1:%2").arg(gpsHost).arg(gpsPort));
+    binLoggerSecondary.setDeviceName(QString("%1:%2").arg(gpsHost).arg(gpsPort));
     binLoggerPrimary.setFilename(gpsBinaryLogFilename);
     binLoggerPrimary.startLogging();
 
@@ -121,34 +130,52 @@ bool gpsNetwork::createConnection()
 void gpsNetwork::readData()
 {
     readingData.lock();
-    QByteArray data;
-    QByteArray dataPrimary;
-    QByteArray dataSecondary;
-
-    tcpsocket->startTransaction();
-    data = tcpsocket->readAll();
-    tcpsocket->commitTransaction();
-
-    QString gpsdataString;
-    gpsdataString = QString("Size: %1, start: 0x%2").arg(data.size()).arg((unsigned char)data.at(0), 2, 16, QChar('0'));
-
-    // Begin decoding in the reader:
-    reader.insertData(deepCopyData(data));
-    gpsMessage m = reader.getMessage(); // copy of entire message
-    //reader.debugThis();
-    if(m.validDecode)
+
+    // Bytes are read straight into the receive ring, and the telegrams
+    // framed there are shared by the decoder and both loggers.
+    // A read may hold part of a telegram, or several of them.
+    while(tcpsocket->bytesAvailable() > 0)
     {
-        dataPrimary = deepCopyData(data);
-        dataSecondary = deepCopyData(data);
+        size_t space = 0;
+        uint8_t *dest = ring.writePointer(&space);
+        qint64 n = tcpsocket->read((char*)dest, space);
+        if(n <= 0)
+            break;
+        ring.commit(n);
+
+        gpsTelegramView telegram;
+        uint32_t byteSum = 0;
+        while(ring.next(framer, &telegram, &byteSum))
+        {
+            // Begin decoding in the reader:
+            reader.insertData(telegram.data(), telegram.length(), byteSum);
+            gpsMessage m = reader.getMessage(); // copy of entire message
+            //reader.debugThis();
+            if(m.validDecode)
+            {
+                binLoggerPrimary.insertData(telegram); // log to binary file
+                binLoggerSecondary.insertData(telegram); // secondary log
+            } else {
+                emit statusMessage(QString("WARNING: Bad GPS decode at counter %1. Error message: [%2] ").arg(m.counter).arg(gpsBinaryReader::decodeErrorString(m)));
+            }
+
+            emit haveGPSMessage(m);
+        }
+    }
 
-        binLoggerPrimary.insertData(dataPrimary); // log to binary file
-        binLoggerSecondary.insertData(dataSecondary); // secondary log
-    } else {
-        emit statusMessage(QString("WARNING: Bad GPS decode at counter %1. Error message: [%2] ").arg(m.counter).arg(m.lastDecodeErrorMessage));
+    if(framer.getBytesSkipped() != lastBytesSkipped)
+    {
+        lastBytesSkipped = framer.getBytesSkipped();
+        emit statusMessage(QString("WARNING: GPS data stream out of sync. Skipped %1 bytes in total, lost sync %2 times, rejected %3 telegrams with bad checksums.")
+                           .arg(framer.getBytesSkipped()).arg(framer.getResyncs()).arg(framer.getChecksumRejects()));
+    }
+    if(ring.getSegmentsAdded() != lastSegmentsAdded)
+    {
+        lastSegmentsAdded = ring.getSegmentsAdded();
+        emit statusMessage(QString("WARNING: GPS receive buffer grown to %1 KiB, logging may be falling behind.")
+                           .arg(ring.getSegmentCount() * gpsReceiveRing::segmentSize / 1024));
     }
 
-    //emit haveGPSString(gpsdataString);
-    emit haveGPSMessage(m);
     readingData.unlock();
 }
 
@@ -196,23 +223,26 @@ void gpsNetwork::handleBinaryLoggingStatusMessage(QString errorString)
     emit haveGPSString(errorString);
 }
 
-bool gpsNetwork::checkConnected()
+void gpsNetwork::setPrimaryLogRotation(const gpsLogRotation &rotation)
 {
-    return connectedToHost;
+    binLoggerPrimary.setRotation(rotation);
 }
 
-QByteArray gpsNetwork::deepCopyData(const QByteArray data)
+void gpsNetwork::setLogFormat(gpsLogFormat format)
 {
-    // This function assures a copy is made at some annoying expense
-    uint16_t sourceLength = data.length();
-    QByteArray dest;
-    volatile char temp = 0;
-    for(int i=0; i < sourceLength; i++)
-    {
-        temp = data.at(i);
-        dest.append(temp);
-    }
-    return dest;
+    binLoggerPrimary.setLogFormat(format);
+    binLoggerSecondary.setLogFormat(format);
+}
+
+void gpsNetwork::setLogUringMode(bool useUring, bool directIO)
+{
+    binLoggerPrimary.setUringMode(useUring, directIO);
+    binLoggerSecondary.setUringMode(useUring, directIO);
+}
+
+bool gpsNetwork::checkConnected()
+{
+    return connectedToHost;
 }
 
 void gpsNetwork::debugThis()
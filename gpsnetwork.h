@@ -9,6 +9,8 @@
 
 #include "gpsbinaryreader.h"
 #include "gpsbinarylogger.h"
+#include "gpsreceivering.h"
+#include "gpstelegramframer.h"
 
 class gpsNetwork : public QObject
 {
@@ -20,13 +22,16 @@ class gpsNetwork : public QObject
     QTcpSocket *tcpsocket;
     QDataStream dataIn;
 
+    gpsTelegramFramer framer;
+    uint64_t lastBytesSkipped = 0;
+    gpsReceiveRing ring; // received bytes, shared with the loggers
+    uint64_t lastSegmentsAdded = 0;
     gpsBinaryReader reader;
     gpsBinaryLogger binLoggerPrimary;
     gpsBinaryLogger binLoggerSecondary;
 
     bool createConnection();
     std::mutex readingData;
-    QByteArray deepCopyData(const QByteArray data);
 
 private slots:
     // for the TCP socket:
@@ -39,6 +44,9 @@ public:
     explicit gpsNetwork(QObject *parent = nullptr);
     ~gpsNetwork();
     bool checkConnected();
+    void setPrimaryLogRotation(const gpsLogRotation &rotation); // before connecting
+    void setLogFormat(gpsLogFormat format); // both logs, before connecting
+    void setLogUringMode(bool useUring, bool directIO); // both logs, before connecting; off by default
 
 public slots:
     void setGPSHost(QString gpsHost, int gpsPort);
@@ -0,0 +1,331 @@
+#include "gpsparalleldecoder.h"
+#include "gpslogcontainer.h"
+#include "gpslogindex.h"
+
+#include <errno.h>
+
+#include <algorithm>
+#include <thread>
+
+int gpsParallelDecoder::open(const std::string &path)
+{
+    close();
+    int err = file.open(path);
+    if(err != 0)
+        return err;
+    container = gpsContainer::isContainer(file.data(), file.size());
+
+    // Known telegram or record starts, to cut the chunks at:
+    gpsLogIndex index;
+    if(index.load(path) == 0)
+    {
+        for(size_t i=0; i < index.size(); i++)
+            indexOffsets.push_back(index.entry(i).offset);
+        std::sort(indexOffsets.begin(), indexOffsets.end());
+    }
+    return 0;
+}
+
+void gpsParallelDecoder::close()
+{
+    file.close();
+    container = false;
+    indexOffsets.clear();
+}
+
+bool gpsParallelDecoder::isOpen()
+{
+    return file.isOpen();
+}
+
+void gpsParallelDecoder::setThreads(unsigned threads)
+{
+    threadCount = threads;
+}
+
+void gpsParallelDecoder::setChunkSize(uint64_t bytes)
+{
+    if(bytes > 0)
+        chunkSize = bytes;
+}
+
+void gpsParallelDecoder::cutChunks()
+{
+    bounds.clear();
+    uint64_t size = file.size();
+    if(size == 0)
+        return;
+    bounds.push_back(0);
+    while(true)
+    {
+        uint64_t target = bounds.back() + chunkSize;
+        if(target >= size)
+            break;
+        if(container || !indexOffsets.empty())
+        {
+            // The first index entry from there on. A raw log's sidecar may
+            // cover only part of it; past that, chunks are cut anywhere.
+            std::vector<uint64_t>::iterator it = std::lower_bound(indexOffsets.begin(), indexOffsets.end(), target);
+            if((it != indexOffsets.end()) && (*it < size))
+                target = *it;
+            else if(container)
+                break;
+        }
+        bounds.push_back(target);
+    }
+    bounds.push_back(size);
+}
+
+int gpsParallelDecoder::run(const chunkHandler &handler)
+{
+    if(!file.isOpen())
+        return EBADF;
+
+    cutChunks();
+    chunkCount = bounds.empty() ? 0 : bounds.size() - 1;
+    telegrams = 0;
+    decodeErrors = 0;
+    dropped = 0;
+    dropEvents = 0;
+    boundaryResyncs = 0;
+
+    usedThreads = threadCount ? threadCount : std::thread::hardware_concurrency();
+    if(usedThreads == 0)
+        usedThreads = 1;
+    if(usedThreads > chunkCount)
+        usedThreads = chunkCount;
+    size_t window = (size_t)std::max(usedThreads, 1u) * maxChunksAhead;
+    chunks.clear();
+    chunks.resize(window);
+    nextChunk = 0;
+    handedOut = 0;
+    stopping = false;
+
+    std::vector<std::thread> workers;
+    for(unsigned i=0; i < usedThreads; i++)
+        workers.push_back(std::thread(&gpsParallelDecoder::worker, this));
+
+    decodePlanCache cache;
+    gpsSequenceTracker sequence;
+    uint64_t nextPos = 0; // where reading straight through would carry on from
+    for(size_t n=0; n < chunkCount; n++)
+    {
+        chunk &c = chunks[n % window];
+        {
+            std::unique_lock<std::mutex> lock(chunkMutex);
+            chunkReady.wait(lock, [&c] { return c.ready; });
+        }
+
+        if(!c.offsets.empty() && (c.offsets[0] < nextPos))
+            resyncChunk(c, nextPos, cache);
+        if(!c.offsets.empty())
+            nextPos = c.endPos;
+
+        for(size_t i=0; i < c.messages.size(); i++)
+        {
+            gpsBinaryReader::trackSequence(c.statuses[i], c.messages[i], sequence);
+            if(c.statuses[i] != decodeOK)
+                decodeErrors++;
+            if(c.messages[i].numberDropped)
+            {
+                dropped += c.messages[i].numberDropped;
+                dropEvents++;
+            }
+        }
+        telegrams += c.messages.size();
+
+        bool more = handler(c.messages, c.statuses);
+        {
+            std::lock_guard<std::mutex> lock(chunkMutex);
+            c.ready = false;
+            handedOut++;
+            if(!more)
+                stopping = true;
+        }
+        chunkFree.notify_all();
+        if(!more)
+            break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(chunkMutex);
+        stopping = true;
+    }
+    chunkFree.notify_all();
+    for(size_t i=0; i < workers.size(); i++)
+        workers[i].join();
+    return 0;
+}
+
+void gpsParallelDecoder::worker()
+{
+    gpsTelegramFramer framer;
+    decodePlanCache cache;
+    size_t window = chunks.size();
+    while(true)
+    {
+        size_t n;
+        {
+            // Wait for the slot to be handed out:
+            std::unique_lock<std::mutex> lock(chunkMutex);
+            chunkFree.wait(lock, [this, window] {
+                return stopping || (nextChunk >= chunkCount) || (nextChunk < handedOut + window);
+            });
+            if(stopping || (nextChunk >= chunkCount))
+                return;
+            n = nextChunk++;
+        }
+
+        chunk &c = chunks[n % window];
+        c.begin = bounds[n];
+        c.end = bounds[n+1];
+        decodeChunk(c, framer, cache);
+
+        {
+            std::lock_guard<std::mutex> lock(chunkMutex);
+            c.ready = true;
+        }
+        chunkReady.notify_all();
+    }
+}
+
+void gpsParallelDecoder::decodeChunk(chunk &c, gpsTelegramFramer &framer, decodePlanCache &cache)
+{
+    // The vectors keep their storage from the chunk before in this slot.
+    c.offsets.clear();
+    c.messages.clear();
+    c.statuses.clear();
+
+    uint64_t pos = c.begin;
+    uint64_t start;
+    const uint8_t *telegram;
+    size_t length;
+    uint32_t byteSum;
+    while(nextTelegram(&pos, c.end, framer, &start, &telegram, &length, &byteSum))
+    {
+        c.offsets.push_back(start);
+        c.messages.emplace_back();
+        c.statuses.push_back(gpsBinaryReader::decode(telegram, length, c.messages.back(), &cache, &byteSum));
+    }
+    c.endPos = pos;
+}
+
+bool gpsParallelDecoder::nextTelegram(uint64_t *pos, uint64_t end, gpsTelegramFramer &framer,
+                                      uint64_t *start, const uint8_t **telegram, size_t *length, uint32_t *byteSum)
+{
+    // The first telegram at or after *pos that starts before end, found
+    // as the replay reader would. *pos is left after it.
+    const uint8_t *data = file.data();
+    uint64_t size = file.size();
+    if(!container)
+    {
+        if(*pos >= end)
+            return false;
+        // A telegram starting before end lies within limit:
+        size_t limit = std::min(size, end + gpsBinaryReader::maxTelegramSize);
+        size_t p = *pos;
+        if(!framer.nextIn(data, limit, &p, telegram, length, byteSum))
+            return false;
+        *start = *telegram - data;
+        if(*start >= end)
+            return false;
+        *pos = p;
+        return true;
+    }
+
+    while((*pos < end) && (*pos + gpsContainer::recordHeaderSize <= size))
+    {
+        gpsRecordHeader h;
+        if(!gpsContainer::getRecordHeader(data + *pos, h))
+        {
+            (*pos)++; // damaged, look for the next record one byte on
+            continue;
+        }
+        uint64_t record = *pos;
+        uint64_t payload = record + gpsContainer::recordHeaderSize;
+        if(payload + h.length > size)
+            return false; // cut short
+        *pos = payload + h.length;
+        size_t p = 0;
+        if((h.kind == recordTelegram) &&
+                framer.nextIn(data + payload, h.length, &p, telegram, length, byteSum) &&
+                (*length == h.length))
+        {
+            *start = record;
+            return true;
+        }
+    }
+    return false;
+}
+
+void gpsParallelDecoder::resyncChunk(chunk &c, uint64_t from, decodePlanCache &cache)
+{
+    // The chunk started inside the last telegram of the one before. Walk
+    // it again from where that one ended, until landing on a telegram the
+    // chunk also has; from there on the two are the same.
+    boundaryResyncs++;
+    std::vector<uint64_t> offsets;
+    std::vector<gpsMessage> messages;
+    std::vector<gpsDecodeStatus> statuses;
+    gpsTelegramFramer framer;
+    uint64_t pos = from;
+    uint64_t start;
+    const uint8_t *telegram;
+    size_t length;
+    uint32_t byteSum;
+    while(nextTelegram(&pos, c.end, framer, &start, &telegram, &length, &byteSum))
+    {
+        std::vector<uint64_t>::iterator it = std::lower_bound(c.offsets.begin(), c.offsets.end(), start);
+        if((it != c.offsets.end()) && (*it == start))
+        {
+            size_t j = it - c.offsets.begin();
+            offsets.insert(offsets.end(), c.offsets.begin() + j, c.offsets.end());
+            messages.insert(messages.end(), c.messages.begin() + j, c.messages.end());
+            statuses.insert(statuses.end(), c.statuses.begin() + j, c.statuses.end());
+            pos = c.endPos;
+            break;
+        }
+        offsets.push_back(start);
+        messages.emplace_back();
+        statuses.push_back(gpsBinaryReader::decode(telegram, length, messages.back(), &cache, &byteSum));
+    }
+    c.offsets.swap(offsets);
+    c.messages.swap(messages);
+    c.statuses.swap(statuses);
+    c.endPos = pos;
+}
+
+unsigned gpsParallelDecoder::getThreads()
+{
+    return usedThreads;
+}
+
+size_t gpsParallelDecoder::getChunks()
+{
+    return chunkCount;
+}
+
+uint64_t gpsParallelDecoder::getTelegrams()
+{
+    return telegrams;
+}
+
+uint64_t gpsParallelDecoder::getDecodeErrors()
+{
+    return decodeErrors;
+}
+
+uint64_t gpsParallelDecoder::getDropped()
+{
+    return dropped;
+}
+
+uint64_t gpsParallelDecoder::getDropEvents()
+{
+    return dropEvents;
+}
+
+uint64_t gpsParallelDecoder::getBoundaryResyncs()
+{
+    return boundaryResyncs;
+}
@@ -0,0 +1,108 @@
+#ifndef GPSPARALLELDECODER_H
+#define GPSPARALLELDECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gpsbinaryreader.h"
+#include "gpsmappedfile.h"
+#include "gpstelegramframer.h"
+
+// Decodes a whole log on several threads, for offline processing.
+//
+// The mapped file is cut into chunks of about chunkSize bytes. Each
+// worker takes the next chunk, finds the first telegram at or after the
+// chunk start the same way the replay reader would, and decodes every
+// telegram that starts before the chunk end. For a container log, or a
+// raw log with a sidecar index, chunks start at index entries, which
+// are known record or telegram starts. Past the last entry of a sidecar,
+// as in the unindexed tail of a growing log, a raw log is cut anywhere.
+//
+// Chunks are handed back in file order, which for a log is counter
+// order. Where a telegram runs over a chunk end, the next chunk may
+// have started inside it; such chunks are walked again from where the
+// one before ended until the two agree. The result is the same
+// sequence as a single read through. Dropped telegrams are counted
+// over the stitched sequence, so drops across chunk ends are seen.
+//
+// At most maxChunksAhead chunks per thread are decoded ahead of the
+// handler, which bounds the memory used whatever the size of the log.
+class gpsParallelDecoder
+{
+public:
+    // Called on the thread in run(), once for each chunk, in file order.
+    // numberDropped is filled in. Return false to stop.
+    typedef std::function<bool(const std::vector<gpsMessage> &messages,
+                               const std::vector<gpsDecodeStatus> &statuses)> chunkHandler;
+
+    static const uint64_t defaultChunkSize = 1 << 20; // about 2500 telegrams
+    static const unsigned maxChunksAhead = 2;
+
+    // Returns 0, or an errno value.
+    int open(const std::string &path);
+    void close();
+    bool isOpen();
+
+    void setThreads(unsigned threads); // 0 for one per core
+    void setChunkSize(uint64_t bytes);
+
+    // Returns 0, or an errno value. May be called again for another pass.
+    int run(const chunkHandler &handler);
+
+    // For the last run():
+    unsigned getThreads();
+    size_t getChunks();
+    uint64_t getTelegrams();
+    uint64_t getDecodeErrors();
+    uint64_t getDropped(); // telegrams missing, by the counter
+    uint64_t getDropEvents(); // gaps in the counter
+    uint64_t getBoundaryResyncs(); // chunks walked again from the one before
+
+private:
+    struct chunk {
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        uint64_t endPos = 0; // after the last telegram
+        std::vector<uint64_t> offsets; // of each telegram, or its record
+        std::vector<gpsMessage> messages;
+        std::vector<gpsDecodeStatus> statuses;
+        bool ready = false;
+    };
+
+    gpsMappedFile file;
+    bool container = false;
+    std::vector<uint64_t> indexOffsets; // from gpsLogIndex, may be empty
+    unsigned threadCount = 0; // as set
+    unsigned usedThreads = 0;
+    uint64_t chunkSize = defaultChunkSize;
+
+    std::vector<uint64_t> bounds; // chunk n is bounds[n] to bounds[n+1]
+    std::vector<chunk> chunks; // by chunk number modulo the window
+    size_t nextChunk = 0; // for the workers to take
+    size_t handedOut = 0; // chunks given to the handler
+    bool stopping = false;
+    std::mutex chunkMutex;
+    std::condition_variable chunkReady;
+    std::condition_variable chunkFree;
+
+    size_t chunkCount = 0;
+    uint64_t telegrams = 0;
+    uint64_t decodeErrors = 0;
+    uint64_t dropped = 0;
+    uint64_t dropEvents = 0;
+    uint64_t boundaryResyncs = 0;
+
+    void cutChunks();
+    void worker();
+    void decodeChunk(chunk &c, gpsTelegramFramer &framer, decodePlanCache &cache);
+    bool nextTelegram(uint64_t *pos, uint64_t end, gpsTelegramFramer &framer,
+                      uint64_t *start, const uint8_t **telegram, size_t *length, uint32_t *byteSum);
+    void resyncChunk(chunk &c, uint64_t from, decodePlanCache &cache);
+};
+
+#endif // GPSPARALLELDECODER_H
@@ -0,0 +1,166 @@
+#include "gpsreceivering.h"
+#include "gpsbinaryreader.h"
+
+#include <string.h>
+
+// Segments:
+
+gpsRingSegment::gpsRingSegment(size_t size) : size(size), refs(1)
+{
+    data = new uint8_t[size];
+}
+
+gpsRingSegment::~gpsRingSegment()
+{
+    delete[] data;
+}
+
+void gpsRingSegment::addRef()
+{
+    refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void gpsRingSegment::release()
+{
+    if(refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+}
+
+// Views:
+
+gpsTelegramView::gpsTelegramView(gpsRingSegment *segment, const uint8_t *bytes, size_t len) :
+    segment(segment), bytes(bytes), len(len)
+{
+    if(segment != NULL)
+        segment->addRef();
+}
+
+gpsTelegramView::gpsTelegramView(const QByteArray &copyFrom)
+{
+    if(copyFrom.isEmpty())
+        return;
+    // The new segment starts with our reference.
+    segment = new gpsRingSegment(copyFrom.length());
+    memcpy(segment->data, copyFrom.constData(), copyFrom.length());
+    bytes = segment->data;
+    len = copyFrom.length();
+}
+
+gpsTelegramView::gpsTelegramView(const gpsTelegramView &other) :
+    segment(other.segment), bytes(other.bytes), len(other.len)
+{
+    if(segment != NULL)
+        segment->addRef();
+}
+
+gpsTelegramView::gpsTelegramView(gpsTelegramView &&other) :
+    segment(other.segment), bytes(other.bytes), len(other.len)
+{
+    other.segment = NULL;
+    other.bytes = NULL;
+    other.len = 0;
+}
+
+gpsTelegramView &gpsTelegramView::operator=(gpsTelegramView other)
+{
+    std::swap(segment, other.segment);
+    std::swap(bytes, other.bytes);
+    std::swap(len, other.len);
+    return *this;
+}
+
+gpsTelegramView::~gpsTelegramView()
+{
+    if(segment != NULL)
+        segment->release();
+}
+
+// The ring:
+
+gpsReceiveRing::gpsReceiveRing()
+{
+    for(size_t i=0; i < initialSegments; i++)
+        segments.push_back(new gpsRingSegment(segmentSize));
+}
+
+gpsReceiveRing::~gpsReceiveRing()
+{
+    // Segments still viewed elsewhere go when their last view does.
+    for(size_t i=0; i < segments.size(); i++)
+        segments[i]->release();
+}
+
+uint8_t *gpsReceiveRing::writePointer(size_t *space)
+{
+    if(segmentSize - filled < gpsBinaryReader::maxTelegramSize)
+        nextSegment();
+    *space = segmentSize - filled;
+    return segments[current]->data + filled;
+}
+
+void gpsReceiveRing::commit(size_t n)
+{
+    filled += n;
+}
+
+bool gpsReceiveRing::next(gpsTelegramFramer &framer, gpsTelegramView *view, uint32_t *byteSum)
+{
+    gpsRingSegment *s = segments[current];
+    const uint8_t *telegram = NULL;
+    size_t length = 0;
+    if(!framer.nextIn(s->data, filled, &framed, &telegram, &length, byteSum))
+        return false;
+    *view = gpsTelegramView(s, telegram, length);
+    return true;
+}
+
+void gpsReceiveRing::nextSegment()
+{
+    // Only the ring's own reference left means nobody is looking at it:
+    size_t n = segments.size();
+    size_t next = n;
+    for(size_t i=1; i < n; i++)
+    {
+        size_t candidate = (current + i) % n;
+        if(segments[candidate]->refs.load(std::memory_order_acquire) == 1)
+        {
+            next = candidate;
+            break;
+        }
+    }
+    if(next == n)
+    {
+        segments.push_back(new gpsRingSegment(segmentSize));
+        segmentsAdded++;
+    }
+
+    // Bring along the start of any telegram still arriving:
+    size_t carry = filled - framed;
+    memcpy(segments[next]->data, segments[current]->data + framed, carry);
+    bytesCarried += carry;
+
+    current = next;
+    filled = carry;
+    framed = 0;
+}
+
+void gpsReceiveRing::reset()
+{
+    filled = 0;
+    framed = 0;
+}
+
+size_t gpsReceiveRing::getSegmentCount()
+{
+    return segments.size();
+}
+
+uint64_t gpsReceiveRing::getSegmentsAdded()
+{
+    return segmentsAdded;
+}
+
+uint64_t gpsReceiveRing::getBytesCarried()
+{
+    return bytesCarried;
+}
@@ -0,0 +1,89 @@
+#ifndef GPSRECEIVERING_H
+#define GPSRECEIVERING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+#include <QByteArray>
+
+#include "gpstelegramframer.h"
+
+// A block of received bytes. It is freed when the last reference goes,
+// which is normally the ring's own, see gpsReceiveRing.
+struct gpsRingSegment {
+    uint8_t *data;
+    size_t size;
+    std::atomic<int> refs;
+
+    gpsRingSegment(size_t size);
+    ~gpsRingSegment();
+    void addRef();
+    void release();
+};
+
+// Read-only view of one telegram held in a gpsRingSegment. Copies are
+// cheap and share the bytes; the segment cannot be reused while any
+// view of it exists. Views may be handed to other threads.
+class gpsTelegramView
+{
+    gpsRingSegment *segment = NULL;
+    const uint8_t *bytes = NULL;
+    size_t len = 0;
+
+public:
+    gpsTelegramView() {}
+    gpsTelegramView(gpsRingSegment *segment, const uint8_t *bytes, size_t len);
+    explicit gpsTelegramView(const QByteArray &copyFrom); // in a segment of its own
+    gpsTelegramView(const gpsTelegramView &other);
+    gpsTelegramView(gpsTelegramView &&other);
+    gpsTelegramView &operator=(gpsTelegramView other);
+    ~gpsTelegramView();
+
+    const uint8_t *data() const { return bytes; }
+    size_t length() const { return len; }
+    bool isEmpty() const { return len == 0; }
+};
+
+// Receive buffer for the TCP connection. The socket reads straight into
+// a preallocated segment, telegrams are framed in place, and each one is
+// handed out as a gpsTelegramView. Nothing is copied after the read,
+// except that a telegram which has only partly arrived when a segment
+// fills up is moved to the start of the next one.
+//
+// A segment is reused once the ring has moved on from it and no views
+// of it are left. If every segment is still referenced, for example by
+// a logger that is behind, another segment is allocated.
+class gpsReceiveRing
+{
+    std::vector<gpsRingSegment*> segments;
+    size_t current = 0;
+    size_t filled = 0; // bytes received into the current segment
+    size_t framed = 0; // bytes of the current segment framed or skipped
+    uint64_t segmentsAdded = 0;
+    uint64_t bytesCarried = 0;
+
+    void nextSegment();
+
+public:
+    static const size_t segmentSize = 65536;
+    static const size_t initialSegments = 8;
+
+    gpsReceiveRing();
+    ~gpsReceiveRing();
+
+    // Where to put the next read, and how much room there is.
+    // There is always room for at least one whole telegram.
+    uint8_t *writePointer(size_t *space);
+    void commit(size_t n); // n bytes were written at writePointer()
+
+    bool next(gpsTelegramFramer &framer, gpsTelegramView *view, uint32_t *byteSum);
+    void reset(); // drops any bytes not yet framed
+
+    size_t getSegmentCount();
+    uint64_t getSegmentsAdded(); // beyond the initial segments
+    uint64_t getBytesCarried();
+};
+
+#endif // GPSRECEIVERING_H
@@ -0,0 +1,140 @@
+#include "gpsreplayclock.h"
+
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+gpsReplayClock::gpsReplayClock()
+{
+    requestedSpeed = 1.0;
+}
+
+int64_t gpsReplayClock::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void gpsReplayClock::sleepUntil(int64_t deadline)
+{
+#ifdef __linux__
+    // An absolute deadline, so a wakeup after a signal does not sleep longer:
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000;
+    ts.tv_nsec = deadline % 1000000000;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+#else
+    int64_t remaining;
+    while((remaining = deadline - now()) > 0)
+    {
+        struct timespec ts;
+        ts.tv_sec = remaining / 1000000000;
+        ts.tv_nsec = remaining % 1000000000;
+        nanosleep(&ts, NULL);
+    }
+#endif
+}
+
+void gpsReplayClock::rebase(uint64_t ticks, int64_t nanoseconds)
+{
+    baseTicks = ticks;
+    baseNanoseconds = nanoseconds;
+}
+
+void gpsReplayClock::reset()
+{
+    started = false;
+    dayOffset = 0;
+    telegrams = 0;
+    resyncs = 0;
+    maxLateness = 0;
+    latenessSum = 0;
+    latenessSumSquares = 0;
+}
+
+void gpsReplayClock::restart()
+{
+    started = false;
+}
+
+void gpsReplayClock::setSpeed(double factor)
+{
+    if(factor > 0)
+        requestedSpeed = factor;
+}
+
+double gpsReplayClock::getSpeed()
+{
+    return requestedSpeed;
+}
+
+int64_t gpsReplayClock::waitFor(uint32_t navDataValidityTime)
+{
+    // Validity times start again at midnight:
+    if(started && (navDataValidityTime + dayLength/2 < lastValidityTime))
+        dayOffset += dayLength;
+    lastValidityTime = navDataValidityTime;
+    uint64_t ticks = navDataValidityTime + dayOffset;
+
+    double wanted = requestedSpeed;
+    if(!started || (wanted != speed))
+    {
+        speed = wanted;
+        started = true;
+        rebase(ticks, now());
+    } else if((ticks < lastTicks) || (ticks - lastTicks > maxGap)) {
+        resyncs++;
+        rebase(ticks, now());
+    }
+    lastTicks = ticks;
+
+    // 100 us per tick:
+    int64_t deadline = baseNanoseconds + (int64_t)((ticks - baseTicks) * (100000.0 / speed));
+    if(deadline > now())
+        sleepUntil(deadline);
+    int64_t woke = now();
+    int64_t lateness = woke - deadline;
+    if(lateness > maxLatenessNs)
+    {
+        resyncs++;
+        rebase(ticks, woke);
+    }
+
+    telegrams++;
+    if(lateness > maxLateness)
+        maxLateness = lateness;
+    latenessSum += lateness;
+    latenessSumSquares += (double)lateness * lateness;
+    return lateness;
+}
+
+uint64_t gpsReplayClock::getTelegrams()
+{
+    return telegrams;
+}
+
+uint64_t gpsReplayClock::getResyncs()
+{
+    return resyncs;
+}
+
+double gpsReplayClock::getMeanLatenessMicroseconds()
+{
+    return telegrams ? latenessSum / telegrams / 1000.0 : 0;
+}
+
+double gpsReplayClock::getJitterMicroseconds()
+{
+    if(telegrams == 0)
+        return 0;
+    double mean = latenessSum / telegrams;
+    double variance = latenessSumSquares / telegrams - mean * mean;
+    return (variance > 0) ? sqrt(variance) / 1000.0 : 0;
+}
+
+double gpsReplayClock::getMaxLatenessMicroseconds()
+{
+    return maxLateness / 1000.0;
+}
@@ -0,0 +1,62 @@
+#ifndef GPSREPLAYCLOCK_H
+#define GPSREPLAYCLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Paces a log replay by the telegrams' own navDataValidityTime, so gaps
+// and changes of rate come out as they were recorded. Each telegram is
+// given an absolute deadline on the monotonic clock, counted from where
+// the replay started, so time spent decoding or oversleeping does not
+// add up over the file.
+//
+// The replay starts over from the current telegram (due at once) when
+// the speed changes, after restart(), when the log time goes backwards
+// or jumps by more than maxGap, and when a telegram is more than
+// maxLatenessNs late, so that a stall is not followed by a burst.
+class gpsReplayClock
+{
+    bool started = false;
+    std::atomic<double> requestedSpeed;
+    double speed = 1.0;
+
+    uint32_t lastValidityTime = 0;
+    uint64_t dayOffset = 0; // added for each midnight crossed
+    uint64_t lastTicks = 0;
+    uint64_t baseTicks = 0; // log time and monotonic time the deadlines count from
+    int64_t baseNanoseconds = 0;
+
+    uint64_t telegrams = 0;
+    uint64_t resyncs = 0; // jumps in log time, and late telegrams
+    int64_t maxLateness = 0;
+    double latenessSum = 0;
+    double latenessSumSquares = 0;
+
+    static int64_t now(); // monotonic, ns
+    static void sleepUntil(int64_t deadline);
+    void rebase(uint64_t ticks, int64_t nanoseconds);
+
+public:
+    static const uint32_t dayLength = 864000000; // in 100 us
+    static const uint64_t maxGap = 100000; // 10 s, in 100 us
+    static const int64_t maxLatenessNs = 500000000;
+
+    gpsReplayClock();
+
+    void reset(); // new replay: forget the position and statistics
+    void restart(); // after a pause or seek: the next telegram is due at once
+    void setSpeed(double factor); // 1 = real time, 0.5 = half speed; from any thread
+    double getSpeed();
+
+    // Sleeps until the telegram is due. Returns how late it was, in ns.
+    int64_t waitFor(uint32_t navDataValidityTime);
+
+    uint64_t getTelegrams();
+    uint64_t getResyncs();
+    double getMeanLatenessMicroseconds();
+    double getJitterMicroseconds(); // standard deviation of the lateness
+    double getMaxLatenessMicroseconds();
+};
+
+#endif // GPSREPLAYCLOCK_H
@@ -0,0 +1,331 @@
+#include "gpssimd.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GPS_SIMD_X86
+#include <immintrin.h>
+#endif
+
+enum simdLevels {
+    simdScalar,
+    simdSSE2,
+    simdSSSE3,
+    simdAVX2
+};
+
+static simdLevels detectSimdLevel()
+{
+#ifdef GPS_SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return simdAVX2;
+    if(__builtin_cpu_supports("ssse3"))
+        return simdSSSE3;
+    if(__builtin_cpu_supports("sse2"))
+        return simdSSE2;
+#endif
+    return simdScalar;
+}
+
+static simdLevels &simdLevelInUse()
+{
+    static simdLevels level = detectSimdLevel();
+    return level;
+}
+
+static simdLevels simdLevel()
+{
+    return simdLevelInUse();
+}
+
+bool setSimdKernel(const char *name)
+{
+    static const char *names[] = { "scalar", "SSE2", "SSSE3", "AVX2" };
+    for(int level=simdScalar; level <= simdAVX2; level++)
+    {
+        if(strcmp(name, names[level]) == 0)
+        {
+            if(level > detectSimdLevel())
+                return false;
+            simdLevelInUse() = (simdLevels)level;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *simdKernelName()
+{
+    switch(simdLevel())
+    {
+    case simdAVX2:
+        return "AVX2";
+    case simdSSSE3:
+        return "SSSE3";
+    case simdSSE2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
+
+// Byte swapping:
+
+static void swapBigEndian32Scalar(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for(size_t i=0; i < count; i++)
+    {
+        uint32_t v = src[3] | (src[2] << 8) | (src[1] << 16) | ((uint32_t)src[0] << 24);
+        memcpy(dst, &v, sizeof(v));
+        dst += 4;
+        src += 4;
+    }
+}
+
+#ifdef GPS_SIMD_X86
+__attribute__((target("ssse3")))
+static void swapBigEndian32SSSE3(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    const __m128i reverse = _mm_set_epi8(12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3);
+    for(; count >= 4; count -= 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)src);
+        _mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(v, reverse));
+        dst += 16;
+        src += 16;
+    }
+    swapBigEndian32Scalar(dst, src, count);
+}
+
+__attribute__((target("avx2")))
+static void swapBigEndian32AVX2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    const __m256i reverse = _mm256_set_epi8(12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3,
+                                            12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3);
+    for(; count >= 8; count -= 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)src);
+        _mm256_storeu_si256((__m256i*)dst, _mm256_shuffle_epi8(v, reverse));
+        dst += 32;
+        src += 32;
+    }
+    swapBigEndian32SSSE3(dst, src, count);
+}
+#endif
+
+void swapBigEndian32(void *dst, const uint8_t *src, size_t count)
+{
+    switch(simdLevel())
+    {
+#ifdef GPS_SIMD_X86
+    case simdAVX2:
+        swapBigEndian32AVX2((uint8_t*)dst, src, count);
+        break;
+    case simdSSSE3:
+        swapBigEndian32SSSE3((uint8_t*)dst, src, count);
+        break;
+#endif
+    default:
+        swapBigEndian32Scalar((uint8_t*)dst, src, count);
+        break;
+    }
+}
+
+// Checksums:
+
+static uint32_t sumBytesScalar(const uint8_t *data, size_t length)
+{
+    uint32_t sum = 0;
+    for(size_t i=0; i < length; i++)
+    {
+        sum += data[i];
+    }
+    return sum;
+}
+
+static uint32_t copyAndSumBytesScalar(uint8_t *dst, const uint8_t *src, size_t length)
+{
+    uint32_t sum = 0;
+    for(size_t i=0; i < length; i++)
+    {
+        dst[i] = src[i];
+        sum += src[i];
+    }
+    return sum;
+}
+
+#ifdef GPS_SIMD_X86
+// psadbw against zero adds up each group of eight bytes into a 64-bit lane.
+
+__attribute__((target("sse2")))
+static uint32_t sumBytesSSE2(const uint8_t *data, size_t length)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 16 <= length; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return (uint32_t)(lanes[0] + lanes[1]) + sumBytesScalar(data + i, length - i);
+}
+
+__attribute__((target("sse2")))
+static uint32_t copyAndSumBytesSSE2(uint8_t *dst, const uint8_t *src, size_t length)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 16 <= length; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return (uint32_t)(lanes[0] + lanes[1]) + copyAndSumBytesScalar(dst + i, src + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t sumBytesAVX2(const uint8_t *data, size_t length)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 32 <= length; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(v, zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return (uint32_t)(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + sumBytesSSE2(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t copyAndSumBytesAVX2(uint8_t *dst, const uint8_t *src, size_t length)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 32 <= length; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(v, zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return (uint32_t)(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + copyAndSumBytesSSE2(dst + i, src + i, length - i);
+}
+#endif
+
+uint32_t sumBytes(const uint8_t *data, size_t length)
+{
+    switch(simdLevel())
+    {
+#ifdef GPS_SIMD_X86
+    case simdAVX2:
+        return sumBytesAVX2(data, length);
+    case simdSSSE3:
+    case simdSSE2:
+        return sumBytesSSE2(data, length);
+#endif
+    default:
+        return sumBytesScalar(data, length);
+    }
+}
+
+uint32_t copyAndSumBytes(uint8_t *dst, const uint8_t *src, size_t length)
+{
+    switch(simdLevel())
+    {
+#ifdef GPS_SIMD_X86
+    case simdAVX2:
+        return copyAndSumBytesAVX2(dst, src, length);
+    case simdSSSE3:
+    case simdSSE2:
+        return copyAndSumBytesSSE2(dst, src, length);
+#endif
+    default:
+        return copyAndSumBytesScalar(dst, src, length);
+    }
+}
+
+// Sync search:
+
+static const uint8_t *findBytePairScalar(const uint8_t *data, size_t length, uint8_t first, uint8_t second)
+{
+    const uint8_t *end = data + length;
+    const uint8_t *p = data;
+    while(end - p >= 2)
+    {
+        p = (const uint8_t*)memchr(p, first, end - p - 1);
+        if(p == NULL)
+            return NULL;
+        if(p[1] == second)
+            return p;
+        p++;
+    }
+    return NULL;
+}
+
+#ifdef GPS_SIMD_X86
+// Compare each position against the first byte, and the position after it
+// against the second, then take the lowest bit where both matched.
+
+__attribute__((target("sse2")))
+static const uint8_t *findBytePairSSE2(const uint8_t *data, size_t length, uint8_t first, uint8_t second)
+{
+    const __m128i a = _mm_set1_epi8((char)first);
+    const __m128i b = _mm_set1_epi8((char)second);
+    size_t i = 0;
+    for(; i + 17 <= length; i += 16)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(data + i + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(v0, a), _mm_cmpeq_epi8(v1, b)));
+        if(mask != 0)
+            return data + i + __builtin_ctz(mask);
+    }
+    return findBytePairScalar(data + i, length - i, first, second);
+}
+
+__attribute__((target("avx2")))
+static const uint8_t *findBytePairAVX2(const uint8_t *data, size_t length, uint8_t first, uint8_t second)
+{
+    const __m256i a = _mm256_set1_epi8((char)first);
+    const __m256i b = _mm256_set1_epi8((char)second);
+    size_t i = 0;
+    for(; i + 33 <= length; i += 32)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(data + i + 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(v0, a), _mm256_cmpeq_epi8(v1, b)));
+        if(mask != 0)
+            return data + i + __builtin_ctz(mask);
+    }
+    return findBytePairSSE2(data + i, length - i, first, second);
+}
+#endif
+
+const uint8_t *findBytePair(const uint8_t *data, size_t length, uint8_t first, uint8_t second)
+{
+    switch(simdLevel())
+    {
+#ifdef GPS_SIMD_X86
+    case simdAVX2:
+        return findBytePairAVX2(data, length, first, second);
+    case simdSSSE3:
+    case simdSSE2:
+        return findBytePairSSE2(data, length, first, second);
+#endif
+    default:
+        return findBytePairScalar(data, length, first, second);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef GPSSIMD_H
+#define GPSSIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bulk kernels for decoding telegrams. Each kernel has a plain C++
+// version and, on x86, SSE2/SSSE3 and AVX2 versions. The fastest version
+// the CPU supports is picked the first time a kernel is called.
+
+// Copy count big-endian 32-bit words from src to dst in host order.
+// dst and src need not be aligned and must not overlap.
+void swapBigEndian32(void *dst, const uint8_t *src, size_t count);
+
+// Unsigned sum of length bytes, modulo 2^32, as used by the telegram checksum:
+uint32_t sumBytes(const uint8_t *data, size_t length);
+
+// Same as sumBytes(), while also copying the bytes from src to dst.
+// Use this when a telegram is being copied anyway, to avoid a second pass.
+uint32_t copyAndSumBytes(uint8_t *dst, const uint8_t *src, size_t length);
+
+// First place in data where the byte pair first, second occurs, or NULL.
+// Used to find the "IX" sync of the next telegram in corrupt data, where
+// looking for 'I' alone stops on every stray 'I'.
+const uint8_t *findBytePair(const uint8_t *data, size_t length, uint8_t first, uint8_t second);
+
+// Name of the instruction set the kernels are using, for status messages:
+const char *simdKernelName();
+
+// For benchmarks: use the kernels for "scalar", "SSE2", "SSSE3" or "AVX2"
+// from now on. Returns false if the CPU does not have them. Not thread
+// safe, so call it before any kernel is in use.
+bool setSimdKernel(const char *name);
+
+#endif // GPSSIMD_H
@@ -0,0 +1,69 @@
+#ifndef GPSSPSCQUEUE_H
+#define GPSSPSCQUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one
+// consumer thread. The capacity is rounded up to a power of two.
+template<typename T>
+class gpsSpscQueue
+{
+    std::vector<T> cells;
+    size_t mask;
+
+    // The two ends are written by different threads, keep them on separate cache lines:
+    char padHead[64];
+    std::atomic<size_t> head; // next slot to pop, written by the consumer
+    char padTail[64];
+    std::atomic<size_t> tail; // next slot to push, written by the producer
+    char padEnd[64];
+
+public:
+    explicit gpsSpscQueue(size_t capacity) : head(0), tail(0)
+    {
+        size_t n = 1;
+        while(n < capacity)
+            n <<= 1;
+        cells.resize(n);
+        mask = n - 1;
+    }
+
+    // Producer only. Returns false, leaving item alone, if the queue is full.
+    bool push(T &&item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(t - head.load(std::memory_order_acquire) == cells.size())
+            return false;
+        cells[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty.
+    bool pop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire))
+            return false;
+        item = std::move(cells[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const
+    {
+        // head first, so it cannot have moved past the tail that is read
+        size_t h = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) - h;
+    }
+
+    size_t capacity() const
+    {
+        return cells.size();
+    }
+};
+
+#endif // GPSSPSCQUEUE_H
@@ -0,0 +1,159 @@
+#include "gpstelegramframer.h"
+#include "gpsbinaryreader.h"
+#include "gpssimd.h"
+
+#include <string.h>
+
+void gpsTelegramFramer::append(const uint8_t *data, size_t length)
+{
+    // Move what is left of the last read to the front first,
+    // so the buffer does not keep growing:
+    if(start == buffer.size())
+    {
+        buffer.clear();
+        start = 0;
+    } else if(start > 0) {
+        buffer.erase(buffer.begin(), buffer.begin() + start);
+        start = 0;
+    }
+    buffer.insert(buffer.end(), data, data + length);
+}
+
+bool gpsTelegramFramer::next(const uint8_t **telegram, size_t *length, uint32_t *byteSum)
+{
+    return nextIn(buffer.data(), buffer.size(), &start, telegram, length, byteSum);
+}
+
+bool gpsTelegramFramer::nextIn(const uint8_t *data, size_t length, size_t *pos,
+                               const uint8_t **telegram, size_t *telegramLength, uint32_t *byteSum)
+{
+    while(*pos < length)
+    {
+        const uint8_t *d = data + *pos;
+        size_t available = length - *pos;
+
+        int size = gpsBinaryReader::telegramLength(d, available);
+        if(size < 0)
+        {
+            // Not a telegram, look for the next one.
+            skip(pos, toNextSync(d, available));
+            continue;
+        }
+        if((size == 0) || ((size_t)size > available))
+        {
+            // Wait for the rest of it.
+            return false;
+        }
+
+        uint32_t sum;
+        if(!checksumMatches(d, size, &sum))
+        {
+            // Either a corrupt telegram, or "IX" turned up in the
+            // middle of one and the size was nonsense.
+            checksumRejects++;
+            skip(pos, 2);
+            continue;
+        }
+
+        inSync = true;
+        telegrams++;
+        *pos += size;
+        *telegram = d;
+        *telegramLength = size;
+        *byteSum = sum;
+        return true;
+    }
+    return false;
+}
+
+const uint8_t *gpsTelegramFramer::findTelegram(const uint8_t *data, size_t length, size_t *telegramLength)
+{
+    size_t pos = 0;
+    while(pos < length)
+    {
+        const uint8_t *d = data + pos;
+        size_t available = length - pos;
+        int size = gpsBinaryReader::telegramLength(d, available);
+        if(size < 0)
+        {
+            pos += toNextSync(d, available);
+            continue;
+        }
+        if((size == 0) || ((size_t)size > available))
+        {
+            *telegramLength = 0;
+            return d;
+        }
+        uint32_t sum;
+        if(checksumMatches(d, size, &sum))
+        {
+            *telegramLength = size;
+            return d;
+        }
+        pos += 2; // "IX" inside something else
+    }
+    return NULL;
+}
+
+size_t gpsTelegramFramer::toNextSync(const uint8_t *d, size_t available)
+{
+    // d is not a telegram. A last byte of 'I' is kept, as the 'X' may
+    // be in the next read.
+    const uint8_t *nextSync = findBytePair(d + 1, available - 1, 'I', 'X');
+    if(nextSync != NULL)
+        return nextSync - d;
+    if((available > 1) && (d[available-1] == 'I'))
+        return available - 1;
+    return available;
+}
+
+bool gpsTelegramFramer::checksumMatches(const uint8_t *telegram, size_t length, uint32_t *byteSum)
+{
+    const uint8_t *d = telegram;
+    uint32_t claimed = d[length-1] | (d[length-2] << 8) | (d[length-3] << 16) | ((uint32_t)d[length-4] << 24);
+    *byteSum = sumBytes(d, length - 4);
+    return *byteSum == claimed;
+}
+
+void gpsTelegramFramer::skip(size_t *pos, size_t n)
+{
+    if(inSync)
+    {
+        inSync = false;
+        resyncs++;
+    }
+    bytesSkipped += n;
+    *pos += n;
+}
+
+void gpsTelegramFramer::reset()
+{
+    buffer.clear();
+    start = 0;
+    inSync = true;
+}
+
+size_t gpsTelegramFramer::bufferedBytes()
+{
+    return buffer.size() - start;
+}
+
+uint64_t gpsTelegramFramer::getTelegrams()
+{
+    return telegrams;
+}
+
+uint64_t gpsTelegramFramer::getBytesSkipped()
+{
+    return bytesSkipped;
+}
+
+uint64_t gpsTelegramFramer::getResyncs()
+{
+    return resyncs;
+}
+
+uint64_t gpsTelegramFramer::getChecksumRejects()
+{
+    return checksumRejects;
+}
@@ -0,0 +1,61 @@
+#ifndef GPSTELEGRAMFRAMER_H
+#define GPSTELEGRAMFRAMER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Cuts a byte stream, such as the TCP connection to the unit, into
+// telegrams. Reads may end part way through a telegram or hold many;
+// bytes are buffered until a whole telegram is available.
+//
+// A telegram is accepted when it starts with the "IX" sync, its
+// totalTelegramSize is plausible, and its checksum matches. Anything
+// else is skipped up to the next "IX", found with findBytePair(), so
+// the framer finds its way back after corrupt or missing data.
+class gpsTelegramFramer
+{
+    std::vector<uint8_t> buffer;
+    size_t start = 0; // first byte not yet framed
+
+    bool inSync = true;
+    uint64_t telegrams = 0;
+    uint64_t bytesSkipped = 0;
+    uint64_t resyncs = 0;
+    uint64_t checksumRejects = 0;
+
+    void skip(size_t *pos, size_t n);
+    static size_t toNextSync(const uint8_t *d, size_t available);
+    static bool checksumMatches(const uint8_t *telegram, size_t length, uint32_t *byteSum);
+
+public:
+    void append(const uint8_t *data, size_t length);
+
+    // Returns the next complete telegram, if there is one. The pointer is
+    // valid until the next call to append() or reset(). byteSum is the sum
+    // of all but the last four bytes, for gpsBinaryReader::insertData().
+    bool next(const uint8_t **telegram, size_t *length, uint32_t *byteSum);
+
+    // The same, for bytes held by the caller, such as gpsReceiveRing:
+    // frames data from *pos up to length, and advances *pos past
+    // whatever was framed or skipped.
+    bool nextIn(const uint8_t *data, size_t length, size_t *pos,
+                const uint8_t **telegram, size_t *telegramLength, uint32_t *byteSum);
+
+    // The next plausible telegram in data, for scanning files: an "IX"
+    // sync, a V2/V3/V5 header with a size in range, and a matching
+    // checksum. One that runs past the end of data cannot be checked, and
+    // comes back with *telegramLength 0, as does a last byte of 'I'.
+    // Returns NULL if there is none.
+    static const uint8_t *findTelegram(const uint8_t *data, size_t length, size_t *telegramLength);
+
+    void reset(); // drops any buffered bytes, keeps the counters
+    size_t bufferedBytes();
+
+    uint64_t getTelegrams();
+    uint64_t getBytesSkipped();
+    uint64_t getResyncs(); // times the framer lost sync
+    uint64_t getChecksumRejects();
+};
+
+#endif // GPSTELEGRAMFRAMER_H
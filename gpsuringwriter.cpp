@@ -0,0 +1,477 @@
+#include "gpsuringwriter.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef GPS_HAVE_URING
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// There is no liburing dependency, the three system calls are used directly:
+
+static int uringSetup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int uringRegister(int ringFd, unsigned opcode, const void *arg, unsigned nrArgs)
+{
+    return (int)syscall(__NR_io_uring_register, ringFd, opcode, arg, nrArgs);
+}
+
+static unsigned *ringField(void *ring, uint32_t offset)
+{
+    return (unsigned*)((char*)ring + offset);
+}
+
+gpsUringWriter::gpsUringWriter()
+{
+    // The buffers are allocated on the first open().
+    iovecs = new struct iovec[bufferCount];
+    for(unsigned i=0; i < bufferCount; i++)
+    {
+        buffers[i].data = NULL;
+        buffers[i].used = 0;
+        buffers[i].done = 0;
+        buffers[i].offset = 0;
+        buffers[i].inFlight = false;
+    }
+}
+
+gpsUringWriter::~gpsUringWriter()
+{
+    if(fd >= 0)
+        close();
+    for(unsigned i=0; i < bufferCount; i++)
+        free(buffers[i].data);
+    delete[] iovecs;
+}
+
+int gpsUringWriter::setupRing()
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ringFd = uringSetup(bufferCount, &p);
+    if(ringFd < 0)
+    {
+        ringFd = -1;
+        return errno;
+    }
+
+    sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(cqRingSize > sqRingSize)
+            sqRingSize = cqRingSize;
+        cqRingSize = 0;
+    }
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if(sqRing == MAP_FAILED)
+    {
+        sqRing = NULL;
+        return errno;
+    }
+    if(cqRingSize == 0)
+    {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if(cqRing == MAP_FAILED)
+        {
+            cqRing = NULL;
+            return errno;
+        }
+    }
+    sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED)
+    {
+        sqes = NULL;
+        return errno;
+    }
+
+    sqTail = ringField(sqRing, p.sq_off.tail);
+    sqMask = ringField(sqRing, p.sq_off.ring_mask);
+    sqArray = ringField(sqRing, p.sq_off.array);
+    cqHead = ringField(cqRing, p.cq_off.head);
+    cqTail = ringField(cqRing, p.cq_off.tail);
+    cqMask = ringField(cqRing, p.cq_off.ring_mask);
+    cqes = (char*)cqRing + p.cq_off.cqes;
+
+    // Registered buffers save pinning the pages on every write. This can
+    // fail against RLIMIT_MEMLOCK, and plain writes work fine without.
+    registered = uringRegister(ringFd, IORING_REGISTER_BUFFERS, iovecs, bufferCount) == 0;
+    return 0;
+}
+
+void gpsUringWriter::teardown()
+{
+    if(sqes != NULL)
+        munmap(sqes, sqesSize);
+    if((cqRing != NULL) && (cqRing != sqRing))
+        munmap(cqRing, cqRingSize);
+    if(sqRing != NULL)
+        munmap(sqRing, sqRingSize);
+    sqes = NULL;
+    sqRing = NULL;
+    cqRing = NULL;
+    if(ringFd >= 0)
+        ::close(ringFd); // also unregisters the buffers
+    ringFd = -1;
+    if(fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+int gpsUringWriter::open(const char *filename, bool directIO)
+{
+    if(fd >= 0)
+        return EBUSY;
+    for(unsigned i=0; i < bufferCount; i++)
+    {
+        if(buffers[i].data == NULL)
+        {
+            void *p = NULL;
+            if(posix_memalign(&p, blockSize, bufferSize) != 0)
+                return ENOMEM;
+            buffers[i].data = (uint8_t*)p;
+        }
+        iovecs[i].iov_base = buffers[i].data;
+        iovecs[i].iov_len = bufferSize;
+    }
+
+    lastError = setupRing();
+    if(lastError != 0)
+    {
+        teardown();
+        return lastError;
+    }
+
+    direct = directIO;
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    fd = ::open(filename, flags | (direct ? O_DIRECT : 0), 0644);
+    if((fd < 0) && direct && (errno == EINVAL))
+    {
+        // tmpfs, for one, does not do O_DIRECT.
+        direct = false;
+        fd = ::open(filename, flags, 0644);
+    }
+    if(fd < 0)
+    {
+        lastError = errno;
+        teardown();
+        return lastError;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        lastError = errno;
+        teardown();
+        return lastError;
+    }
+    fileOffset = st.st_size;
+    if(direct && (fileOffset % blockSize != 0))
+    {
+        // Appending to a log that was not written in direct mode:
+        direct = false;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    }
+    preallocatedTo = fileOffset;
+    preallocate = true;
+
+    current = 0;
+    for(unsigned i=0; i < bufferCount; i++)
+    {
+        buffers[i].used = 0;
+        buffers[i].inFlight = false;
+    }
+    return 0;
+}
+
+int gpsUringWriter::preallocateAhead(uint64_t bytes)
+{
+    if(fd < 0)
+        return EBADF;
+    if(fileOffset + bytes <= preallocatedTo)
+        return 0;
+    if(fallocate(fd, FALLOC_FL_KEEP_SIZE, fileOffset, bytes) != 0)
+        return errno;
+    preallocatedTo = fileOffset + bytes;
+    return 0;
+}
+
+int gpsUringWriter::submit(unsigned index)
+{
+    buffer &b = buffers[index];
+    unsigned tail = *sqTail; // only this thread moves the tail
+    unsigned slot = tail & *sqMask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe*)sqes + slot;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = fd;
+    sqe->off = b.offset + b.done;
+    sqe->user_data = index;
+    if(registered)
+    {
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->addr = (uint64_t)(uintptr_t)(b.data + b.done);
+        sqe->len = b.used - b.done;
+        sqe->buf_index = index;
+    } else {
+        iovecs[index].iov_base = b.data + b.done;
+        iovecs[index].iov_len = b.used - b.done;
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->addr = (uint64_t)(uintptr_t)&iovecs[index];
+        sqe->len = 1;
+    }
+    sqArray[slot] = slot;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    b.inFlight = true;
+    submissions++;
+    int rtn;
+    do {
+        rtn = uringEnter(ringFd, 1, 0, 0);
+    } while((rtn < 0) && (errno == EINTR));
+    if(rtn < 0)
+        return errno;
+    return 0;
+}
+
+int gpsUringWriter::reap(bool wait)
+{
+    // Returns an error only if the ring itself fails. A failed write
+    // is kept in lastError, and the other completions still come in.
+    while(true)
+    {
+        unsigned head = *cqHead;
+        if(head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        {
+            if(!wait)
+                return 0;
+            if((uringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0) && (errno != EINTR))
+                return errno;
+            continue;
+        }
+        struct io_uring_cqe *cqe = (struct io_uring_cqe*)cqes + (head & *cqMask);
+        unsigned index = (unsigned)cqe->user_data;
+        int res = cqe->res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+        buffer &b = buffers[index];
+        if(res > 0)
+        {
+            bytesWritten += res;
+            b.done += res;
+        }
+        if((res > 0) && (b.done < b.used))
+        {
+            // A short write, send the rest:
+            int err = submit(index);
+            if(err != 0)
+                return err;
+            continue;
+        }
+        if((res <= 0) && (lastError == 0))
+            lastError = (res < 0) ? -res : EIO;
+        b.inFlight = false;
+        wait = false; // a buffer is free, that is enough
+    }
+}
+
+int gpsUringWriter::submitCurrent()
+{
+    buffer &b = buffers[current];
+    b.offset = fileOffset;
+    b.done = 0;
+    fileOffset += b.used;
+
+    // Keep the preallocation a step ahead of the writes. Without
+    // FALLOC_FL_KEEP_SIZE readers would see zeros past the real end.
+    if(preallocate && (fileOffset + bufferSize > preallocatedTo))
+    {
+        if(fallocate(fd, FALLOC_FL_KEEP_SIZE, preallocatedTo, preallocateStep) == 0)
+            preallocatedTo += preallocateStep;
+        else
+            preallocate = false; // not supported here
+    }
+
+    int err = submit(current);
+    if(err != 0)
+        return err;
+
+    // Move on, waiting for the next buffer if it is still being written:
+    current = (current + 1) % bufferCount;
+    err = reap(false);
+    if(buffers[current].inFlight)
+        bufferWaits++;
+    while((err == 0) && buffers[current].inFlight)
+        err = reap(true);
+    if(err != 0)
+        return err;
+    buffers[current].used = 0;
+    return lastError;
+}
+
+int gpsUringWriter::append(const uint8_t *data, size_t length)
+{
+    if(fd < 0)
+        return EBADF;
+    if(lastError != 0)
+        return lastError;
+    while(length > 0)
+    {
+        buffer &b = buffers[current];
+        size_t n = bufferSize - b.used;
+        if(n > length)
+            n = length;
+        memcpy(b.data + b.used, data, n);
+        b.used += n;
+        data += n;
+        length -= n;
+        if(b.used == bufferSize)
+        {
+            int err = submitCurrent();
+            if(err != 0)
+                return err;
+        }
+    }
+    return 0;
+}
+
+int gpsUringWriter::flush()
+{
+    if(fd < 0)
+        return EBADF;
+    if(lastError != 0)
+        return lastError;
+    // Direct writes must be whole blocks, so those wait for a full buffer.
+    if(!direct && (buffers[current].used > 0))
+        return submitCurrent();
+    int err = reap(false);
+    return (err != 0) ? err : lastError;
+}
+
+int gpsUringWriter::close()
+{
+    if(fd < 0)
+        return EBADF;
+    int err = lastError;
+    uint64_t logicalSize = fileOffset + buffers[current].used;
+    if((err == 0) && (buffers[current].used > 0))
+    {
+        buffer &b = buffers[current];
+        if(direct)
+        {
+            size_t padded = (b.used + blockSize - 1) / blockSize * blockSize;
+            memset(b.data + b.used, 0, padded - b.used);
+            b.used = padded;
+        }
+        err = submitCurrent();
+    }
+    for(unsigned i=0; i < bufferCount; i++)
+    {
+        int ringErr = 0;
+        while((ringErr == 0) && buffers[i].inFlight)
+            ringErr = reap(true);
+        if(err == 0)
+            err = ringErr;
+    }
+    if(err == 0)
+        err = lastError;
+    // Drops the padding and whatever was preallocated but not used:
+    if((ftruncate(fd, logicalSize) != 0) && (err == 0))
+        err = errno;
+    teardown();
+    lastError = 0;
+    return err;
+}
+
+#else
+
+// Stubs where there is no io_uring, so that open() fails and the caller
+// keeps to stdio.
+
+gpsUringWriter::gpsUringWriter()
+{
+    iovecs = NULL;
+}
+
+gpsUringWriter::~gpsUringWriter()
+{
+}
+
+int gpsUringWriter::open(const char *filename, bool directIO)
+{
+    (void)filename;
+    (void)directIO;
+    return ENOSYS;
+}
+
+int gpsUringWriter::preallocateAhead(uint64_t bytes)
+{
+    (void)bytes;
+    return EBADF;
+}
+
+int gpsUringWriter::append(const uint8_t *data, size_t length)
+{
+    (void)data;
+    (void)length;
+    return EBADF;
+}
+
+int gpsUringWriter::flush()
+{
+    return EBADF;
+}
+
+int gpsUringWriter::close()
+{
+    return EBADF;
+}
+
+#endif // GPS_HAVE_URING
+
+bool gpsUringWriter::isOpen()
+{
+    return fd >= 0;
+}
+
+bool gpsUringWriter::isDirect()
+{
+    return direct;
+}
+
+uint64_t gpsUringWriter::getOffset()
+{
+    return fileOffset + buffers[current].used;
+}
+
+uint64_t gpsUringWriter::getSubmissions()
+{
+    return submissions;
+}
+
+uint64_t gpsUringWriter::getBufferWaits()
+{
+    return bufferWaits;
+}
+
+uint64_t gpsUringWriter::getBytesWritten()
+{
+    return bytesWritten;
+}
@@ -0,0 +1,104 @@
+#ifndef GPSURINGWRITER_H
+#define GPSURINGWRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define GPS_HAVE_URING
+#endif
+#endif
+
+struct iovec;
+
+// Appends to a log file through io_uring. Data is copied into a small
+// set of aligned, registered buffers; a full buffer is submitted as one
+// write and the caller carries on filling the next while it completes.
+// The file is preallocated ahead of the writes with fallocate().
+//
+// In direct mode the file is opened O_DIRECT, so the log does not pass
+// through the page cache. Writes are then whole buffers only, and the
+// last partial buffer is padded out and trimmed off again in close().
+// Until a buffer fills, its telegrams are only in memory, so direct
+// mode is for high rates, and has to be asked for.
+//
+// Not thread safe: used through gpsLogFile by the gpsBinaryLogger
+// writer thread. Where io_uring is not available open() fails, and
+// gpsLogFile falls back to plain writes.
+class gpsUringWriter
+{
+    struct buffer {
+        uint8_t *data;
+        size_t used; // bytes to write, including any padding
+        size_t done; // bytes written so far
+        uint64_t offset; // where in the file
+        bool inFlight;
+    };
+
+    int fd = -1;
+    bool direct = false;
+    uint64_t fileOffset = 0; // where the next buffer goes
+    uint64_t preallocatedTo = 0;
+    bool preallocate = true;
+    int lastError = 0;
+
+    buffer buffers[16];
+    struct iovec *iovecs = NULL;
+    unsigned current = 0;
+    bool registered = false;
+
+    // The ring, mapped from the kernel:
+    int ringFd = -1;
+    void *sqRing = NULL;
+    void *cqRing = NULL;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    void *sqes = NULL;
+    size_t sqesSize = 0;
+    unsigned *sqTail = NULL;
+    unsigned *sqMask = NULL;
+    unsigned *sqArray = NULL;
+    unsigned *cqHead = NULL;
+    unsigned *cqTail = NULL;
+    unsigned *cqMask = NULL;
+    void *cqes = NULL;
+
+    uint64_t submissions = 0;
+    uint64_t bufferWaits = 0;
+    uint64_t bytesWritten = 0;
+
+    int setupRing();
+    void teardown();
+    int submit(unsigned index);
+    int reap(bool wait);
+    int submitCurrent();
+
+public:
+    static const size_t blockSize = 4096; // O_DIRECT alignment
+    static const size_t bufferSize = 65536;
+    static const unsigned bufferCount = 16;
+    static const off_t preallocateStep = 16*1024*1024;
+
+    gpsUringWriter();
+    ~gpsUringWriter();
+
+    // Returns 0, or an errno value. Appends to the file if it exists.
+    // Direct mode is dropped if the file system refuses O_DIRECT or the
+    // file does not end on a block boundary.
+    int open(const char *filename, bool directIO);
+    int preallocateAhead(uint64_t bytes); // beyond the regular steps
+    int append(const uint8_t *data, size_t length);
+    int flush(); // submits what has been appended, except in direct mode
+    int close(); // writes everything out and waits for it
+    bool isOpen();
+    bool isDirect();
+    uint64_t getOffset(); // where the next append goes
+
+    uint64_t getSubmissions();
+    uint64_t getBufferWaits(); // times every buffer was still being written
+    uint64_t getBytesWritten();
+};
+
+#endif // GPSURINGWRITER_H